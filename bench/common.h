@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// runs f repetitions times, after one untimed warm-up run, and returns the
+// average time per run in microseconds.
+template <typename F>
+double time_us(F f, const std::size_t repetitions)
+{
+  f();
+
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < repetitions; ++i) {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         static_cast<double>(repetitions);
+}
+
+// prints the timings of a reference and a candidate implementation.
+void report(const std::string& name, const double reference_us,
+            const double candidate_us);
+
+void bench_matrix();
+void bench_p_local();
+void bench_smith();
@@ -0,0 +1,24 @@
+#include <iomanip>
+#include <iostream>
+
+#include "common.h"
+
+void report(const std::string& name, const double reference_us,
+            const double candidate_us)
+{
+  std::cout << std::left << std::setw(40) << name << std::right
+            << std::setw(12) << std::fixed << std::setprecision(2)
+            << reference_us << " us" << std::setw(12) << candidate_us
+            << " us" << std::setw(10) << reference_us / candidate_us << "x\n";
+}
+
+int main()
+{
+  std::cout << std::left << std::setw(40) << "benchmark" << std::right
+            << std::setw(15) << "reference" << std::setw(15) << "candidate"
+            << std::setw(11) << "speedup\n";
+
+  bench_p_local();
+  bench_matrix();
+  bench_smith();
+}
@@ -0,0 +1,91 @@
+#include <string>
+
+#include <gmpxx.h>
+
+#include "common.h"
+
+#include "../src/matrix.h"
+#include "../src/thread_pool.h"
+
+// the implementation of operator* before tiling and threading.
+static MatrixQ multiply_reference(const MatrixQ& g, const MatrixQ& f)
+{
+  MatrixQ gf(g.height(), f.width());
+  for (dim_t i = 0; i < g.height(); ++i) {
+    for (dim_t j = 0; j < f.width(); ++j) {
+      mpq_class acc;
+
+      for (dim_t k = 0; k < g.width(); ++k) {
+        acc += g(i, k) * f(k, j);
+      }
+
+      gf(i, j) = acc;
+    }
+  }
+
+  return gf;
+}
+
+// a matrix of small rationals, about a third of them zero.
+static MatrixQ sample(const dim_t n, const dim_t seed)
+{
+  MatrixQ f(n, n);
+  for (dim_t i = 0; i < n; ++i) {
+    for (dim_t j = 0; j < n; ++j) {
+      dim_t x = (i * 31 + j * 17 + seed) % 23;
+      if (x % 3 == 0) continue;
+      f(i, j) = mpq_class(static_cast<long>(x) - 11) / ((i + j) % 4 + 1);
+    }
+  }
+  return f;
+}
+
+static void bench_product(const dim_t n, const unsigned int threads)
+{
+  MatrixQ g = sample(n, 1);
+  MatrixQ f = sample(n, 2);
+  volatile dim_t sink = 0;
+
+  unsigned int previous_threads = get_thread_count();
+  set_thread_count(threads);
+
+  double reference = time_us(
+      [&] { sink = sink + multiply_reference(g, f).height(); }, 3);
+  double candidate = time_us([&] { sink = sink + (g * f).height(); }, 3);
+
+  set_thread_count(previous_threads);
+
+  report("operator* " + std::to_string(n) + "x" + std::to_string(n) + " " +
+             std::to_string(threads) + " thread(s)",
+         reference, candidate);
+}
+
+// the column operations smith_reduce_p applies to the maps from a group.
+static void bench_col_add(const dim_t n)
+{
+  MatrixQ rows = sample(n, 3);
+  MatrixQ cols = rows;
+  cols.set_layout(Layout::column_major);
+  const mpq_class lambda(3, 2);
+
+  auto sweep = [&](MatrixQ& f) {
+    for (dim_t j = 1; j < n; ++j) {
+      f.col_add(0, j, lambda);
+    }
+  };
+
+  double reference = time_us([&] { sweep(rows); }, 3);
+  double candidate = time_us([&] { sweep(cols); }, 3);
+
+  report("col_add " + std::to_string(n) + "x" + std::to_string(n) +
+             " column-major",
+         reference, candidate);
+}
+
+void bench_matrix()
+{
+  bench_product(64, 1);
+  bench_product(128, 1);
+  bench_product(128, 4);
+  bench_col_add(256);
+}
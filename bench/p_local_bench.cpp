@@ -0,0 +1,114 @@
+#include <limits>
+#include <vector>
+
+#include <gmpxx.h>
+
+#include "common.h"
+
+#include "../src/matrix.h"
+#include "../src/p_local.h"
+
+// the implementation of p_val_z before the mpz_scan1 / mpz_remove kernels.
+static val_t p_val_z_reference(const mod_t p, const mpz_class& x)
+{
+  if (x == 0) return std::numeric_limits<val_t>::max();
+
+  val_t val = 0;
+  mpz_class remainder = x;
+
+  while (mpz_divisible_ui_p(remainder.get_mpz_t(), p)) {
+    val++;
+    mpz_divexact_ui(remainder.get_mpz_t(), remainder.get_mpz_t(), p);
+  }
+
+  return val;
+}
+
+static val_t p_val_q_reference(const mod_t p, const mpq_class& x)
+{
+  val_t num_valuation = p_val_z_reference(p, x.get_num());
+
+  if (num_valuation > 0)
+    return num_valuation;
+  else
+    return -p_val_z_reference(p, x.get_den());
+}
+
+// numbers p^k * u for units u and k = 0, ..., max_exp - 1.
+static std::vector<mpz_class> sample(const mod_t p, const u_val_t max_exp)
+{
+  std::vector<mpz_class> result;
+  for (u_val_t k = 0; k < max_exp; ++k) {
+    result.push_back(p_pow_z(p, k) * (p * k + 1));
+  }
+  return result;
+}
+
+static void bench_p_val_z(const mod_t p, const u_val_t max_exp)
+{
+  std::vector<mpz_class> xs = sample(p, max_exp);
+  volatile val_t sink = 0;
+
+  double reference = time_us(
+      [&] {
+        for (const mpz_class& x : xs) sink = sink + p_val_z_reference(p, x);
+      },
+      200);
+  double candidate = time_us(
+      [&] {
+        for (const mpz_class& x : xs) sink = sink + p_val_z(p, x);
+      },
+      200);
+
+  report("p_val_z p=" + std::to_string(p) + " k<" + std::to_string(max_exp),
+         reference, candidate);
+}
+
+static void bench_p_val_row(const mod_t p, const dim_t n)
+{
+  MatrixQ f(n, n);
+  for (dim_t i = 0; i < n; ++i) {
+    for (dim_t j = 0; j < n; ++j) {
+      f(i, j) = mpq_class(p_pow_z(p, (i * n + j) % 16) * (i + 2 * j + 1),
+                          p * j + 1);
+      f(i, j).canonicalize();
+    }
+  }
+
+  const MatrixQ& f_const = f;
+  std::vector<val_t> valuations(n);
+  volatile val_t sink = 0;
+
+  double reference = time_us(
+      [&] {
+        for (dim_t i = 0; i < n; ++i) {
+          for (dim_t j = 0; j < n; ++j) {
+            valuations[j] = p_val_q_reference(p, f_const(i, j));
+          }
+          sink = sink + valuations[0];
+        }
+      },
+      20);
+  double candidate = time_us(
+      [&] {
+        for (dim_t i = 0; i < n; ++i) {
+          p_val_row(Prime<0>(p), f_const, i, 0, valuations);
+          sink = sink + valuations[0];
+        }
+      },
+      20);
+
+  report("p_val_row p=" + std::to_string(p) + " " + std::to_string(n) + "x" +
+             std::to_string(n),
+         reference, candidate);
+}
+
+void bench_p_local()
+{
+  bench_p_val_z(2, 64);
+  bench_p_val_z(2, 1024);
+  bench_p_val_z(3, 64);
+  bench_p_val_z(3, 1024);
+  bench_p_val_row(2, 64);
+  bench_p_val_row(3, 64);
+}
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <gmpxx.h>
+
+#include "common.h"
+
+#include "../src/matrix.h"
+#include "../src/mod_pn.h"
+#include "../src/p_local.h"
+#include "../src/smith.h"
+
+// smith_valuations_p before the valuation shadow: every step computes the
+// valuations of the whole remaining block.
+static std::vector<val_t> smith_valuations_reference(const mod_t p,
+                                                     MatrixQ f)
+{
+  mpq_class lambda;
+  std::vector<val_t> valuations;
+  std::vector<val_t> diagonal;
+  for (dim_t d = 0; d < std::min(f.height(), f.width()); ++d) {
+    dim_t i_min = 0;
+    dim_t j_min = 0;
+    val_t min_valuation = std::numeric_limits<val_t>::max();
+
+    for (dim_t i = d; i < f.height(); ++i) {
+      p_val_row(Prime<0>(p), f, i, d, valuations);
+      for (dim_t j = d; j < f.width(); ++j) {
+        if (valuations[j - d] < min_valuation) {
+          i_min = i;
+          j_min = j;
+          min_valuation = valuations[j - d];
+        }
+      }
+    }
+
+    if (min_valuation == std::numeric_limits<val_t>::max()) break;
+
+    f.row_swap(i_min, d);
+    f.col_swap(j_min, d);
+    diagonal.push_back(min_valuation);
+
+    MatrixVector<mpq_class> pivot_row = f.row(d);
+    for (dim_t i = d + 1; i < f.height(); ++i) {
+      MatrixVector<mpq_class> row = f.row(i);
+      if (!row[d]) continue;
+
+      lambda = -row[d] / pivot_row[d];
+      for (dim_t j = d + 1; j < f.width(); ++j) {
+        mul_add(row[j], lambda, pivot_row[j]);
+      }
+    }
+  }
+
+  return diagonal;
+}
+
+// a sparse matrix with entries divisible by varying powers of p, so that most
+// rows are left alone by most steps.
+static MatrixQ sample(const mod_t p, const dim_t n)
+{
+  MatrixQ f(n, n);
+  for (dim_t i = 0; i < n; ++i) {
+    f(i, (i * 7) % n) = mpq_class(p * p * (i % 5 + 1));
+    f(i, (i * 7 + 3) % n) = mpq_class(p * (i % 3 + 1) + 1) / (p + 1);
+    if (i % 4 == 0) f(i, (i * 5 + 1) % n) = mpq_class(p * p * p);
+  }
+  return f;
+}
+
+static void bench_valuations(const mod_t p, const dim_t n)
+{
+  MatrixQ f = sample(p, n);
+  volatile dim_t sink = 0;
+
+  double reference = time_us(
+      [&] { sink = sink + smith_valuations_reference(p, f).size(); }, 3);
+  double candidate =
+      time_us([&] { sink = sink + smith_valuations_p(p, f).size(); }, 3);
+
+  report("smith_valuations_p p=" + std::to_string(p) + " " +
+             std::to_string(n) + "x" + std::to_string(n),
+         reference, candidate);
+}
+
+static void bench_engine(const mod_t p, const dim_t n)
+{
+  MatrixQ f = sample(p, n);
+  volatile dim_t sink = 0;
+
+  auto reduce = [&](const SmithEngine engine) {
+    set_smith_engine(engine);
+    MatrixQ g = f;
+    BasisChange<mpq_class> X_change;
+    BasisChange<mpq_class> Y_change;
+    if (engine == SmithEngine::dense)
+      dense_smith_reduce_p(p, g, X_change, Y_change);
+    else
+      smith_reduce_p(p, g, X_change, Y_change);
+    sink = sink + X_change.size() + Y_change.size();
+  };
+
+  double reference = time_us([&] { reduce(SmithEngine::dense); }, 3);
+  double candidate = time_us([&] { reduce(SmithEngine::sparse); }, 3);
+  set_smith_engine(SmithEngine::dense);
+
+  report("sparse_smith_reduce_p p=" + std::to_string(p) + " " +
+             std::to_string(n) + "x" + std::to_string(n),
+         reference, candidate);
+}
+
+// a dense matrix in Z/p^N, whose entries do not grow during the reduction.
+static void bench_block(const mod_t p, const dim_t n)
+{
+  ModPN::Context context(p, 16);
+  Matrix<ModPN> f(n, n);
+  for (dim_t i = 0; i < n; ++i) {
+    for (dim_t j = 0; j < n; ++j) {
+      f(i, j) = static_cast<int>((i * 7 + j * j + 1) % 23) *
+                (i % 3 == 0 ? static_cast<int>(p) : 1);
+    }
+  }
+  volatile dim_t sink = 0;
+
+  auto reduce = [&](const bool block) {
+    Matrix<ModPN> g = f;
+    BasisChange<ModPN> X_change;
+    BasisChange<ModPN> Y_change;
+    if (block)
+      block_smith_reduce_p(p, g, X_change, Y_change);
+    else
+      dense_smith_reduce_p(p, g, X_change, Y_change);
+    sink = sink + X_change.size() + Y_change.size();
+  };
+
+  double reference = time_us([&] { reduce(false); }, 3);
+  double candidate = time_us([&] { reduce(true); }, 3);
+
+  report("block_smith_reduce_p Z/" + std::to_string(p) + "^16 " +
+             std::to_string(n) + "x" + std::to_string(n),
+         reference, candidate);
+}
+
+void bench_smith()
+{
+  bench_valuations(3, 64);
+  bench_engine(3, 96);
+  bench_block(3, 256);
+}
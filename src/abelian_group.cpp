@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <gmpxx.h>
 
 #include "abelian_group.h"
@@ -8,36 +10,13 @@ AbelianGroup::AbelianGroup(const dim_t free_rank, const dim_t tor_rank)
 {
 }
 
-template <>
-AbelianGroup::TorsionMatrix<mpq_class>::TorsionMatrix(const AbelianGroup& group,
-                                                      const mod_t p)
-    : group_(group), p_(p)
-{
-}
-
-template <>
-dim_t AbelianGroup::TorsionMatrix<mpq_class>::height() const
-{
-  return group_.tor_rank();
-}
-
-template <>
-dim_t AbelianGroup::TorsionMatrix<mpq_class>::width() const
+dim_t AbelianGroup::max_order() const
 {
-  return group_.tor_rank();
-}
-
-template <>
-mpq_class AbelianGroup::TorsionMatrix<mpq_class>::operator()(
-    const dim_t i, const dim_t j) const
-{
-  return i == j ? p_pow_z(p_, group_.orders_[i]) : 0;
-}
-
-AbelianGroup::TorsionMatrix<mpq_class> AbelianGroup::torsion_matrix(
-    const mod_t p) const
-{
-  return AbelianGroup::TorsionMatrix<mpq_class>(*this, p);
+  dim_t result = 0;
+  for (dim_t order : orders_) {
+    result = std::max(result, order);
+  }
+  return result;
 }
 
 void AbelianGroup::print(std::ostream& stream, mod_t p)
@@ -50,7 +29,7 @@ void AbelianGroup::print(std::ostream& stream, mod_t p)
   }
   for (dim_t i = 0; i < tor_rank(); i++) {
     if (plus) stream << " + ";
-    mpz_class order = p_pow_z(p, orders_[i]);
+    const mpz_class& order = p_pow_z(p, orders_[i]);
     stream << "Z/";
     stream << order.get_str(10);
     plus = true;
@@ -7,6 +7,8 @@
 
 class AbelianGroup
 {
+  // the diagonal matrix of the orders. The powers of p are looked up once on
+  // construction, so reading an entry does not compute anything.
   template <typename T>
   class TorsionMatrix : public MatrixExpression<T, TorsionMatrix>
   {
@@ -16,11 +18,11 @@ class AbelianGroup
     dim_t height() const;
     dim_t width() const;
 
-    T operator()(const dim_t i, const dim_t j) const;
+    const T& operator()(const dim_t i, const dim_t j) const;
 
    private:
-    const AbelianGroup& group_;
-    const mod_t p_;
+    std::vector<T> diagonal_;
+    T zero_;
   };
 
  public:
@@ -52,9 +54,20 @@ class AbelianGroup
     return free_rank() + tor_rank();
   }
 
-  TorsionMatrix<mpq_class> torsion_matrix(const mod_t p) const;
+  dim_t max_order() const;
+
+  template <typename T = mpq_class>
+  TorsionMatrix<T> torsion_matrix(const mod_t p) const;
   void print(std::ostream& stream, mod_t p);
  private:
   dim_t free_rank_;
   std::vector<dim_t> orders_;
 };
+
+template <typename T>
+struct MatrixEntry<T, AbelianGroup::TorsionMatrix>
+{
+  using type = const T&;
+};
+
+#include "abelian_group_impl.h"
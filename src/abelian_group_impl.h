@@ -0,0 +1,38 @@
+#include "p_local.h"
+
+template <typename T>
+AbelianGroup::TorsionMatrix<T>::TorsionMatrix(const AbelianGroup& group,
+                                              const mod_t p)
+    : zero_(0)
+{
+  diagonal_.reserve(group.tor_rank());
+  for (dim_t order : group.orders_) {
+    diagonal_.push_back(p_pow<T>(p, order));
+  }
+}
+
+template <typename T>
+dim_t AbelianGroup::TorsionMatrix<T>::height() const
+{
+  return diagonal_.size();
+}
+
+template <typename T>
+dim_t AbelianGroup::TorsionMatrix<T>::width() const
+{
+  return diagonal_.size();
+}
+
+template <typename T>
+const T& AbelianGroup::TorsionMatrix<T>::operator()(const dim_t i,
+                                                    const dim_t j) const
+{
+  return i == j ? diagonal_[i] : zero_;
+}
+
+template <typename T>
+AbelianGroup::TorsionMatrix<T> AbelianGroup::torsion_matrix(
+    const mod_t p) const
+{
+  return AbelianGroup::TorsionMatrix<T>(*this, p);
+}
@@ -0,0 +1,278 @@
+#include "hybrid_q.h"
+
+#include <exception>
+#include <limits>
+
+#include "p_local.h"
+
+static std::uint64_t gcd(std::uint64_t a, std::uint64_t b)
+{
+  while (b != 0) {
+    std::uint64_t remainder = a % b;
+    a = b;
+    b = remainder;
+  }
+  return a;
+}
+
+// small values never take the value INT64_MIN, so negation is always safe.
+static std::uint64_t abs_u(const std::int64_t x)
+{
+  return static_cast<std::uint64_t>(x < 0 ? -x : x);
+}
+
+static bool add_checked(const std::int64_t a, const std::int64_t b,
+                        std::int64_t& result)
+{
+  return !__builtin_add_overflow(a, b, &result) &&
+         result != std::numeric_limits<std::int64_t>::min();
+}
+
+static bool mul_checked(const std::int64_t a, const std::int64_t b,
+                        std::int64_t& result)
+{
+  return !__builtin_mul_overflow(a, b, &result) &&
+         result != std::numeric_limits<std::int64_t>::min();
+}
+
+static bool fits_small(const mpz_class& x)
+{
+  return x.fits_slong_p() &&
+         x.get_si() != std::numeric_limits<std::int64_t>::min();
+}
+
+static val_t p_val_u(const mod_t p, std::uint64_t x)
+{
+  val_t val = 0;
+  while (x % p == 0) {
+    ++val;
+    x /= p;
+  }
+  return val;
+}
+
+HybridQ::HybridQ(const int x) : num_(x)
+{
+}
+
+HybridQ::HybridQ(const mpz_class& x)
+{
+  set(mpq_class(x));
+}
+
+HybridQ::HybridQ(const mpq_class& x)
+{
+  set(x);
+}
+
+HybridQ::HybridQ(const HybridQ& other)
+    : num_(other.num_),
+      den_(other.den_),
+      big_(other.big_ ? new mpq_class(*other.big_) : nullptr)
+{
+}
+
+HybridQ& HybridQ::operator=(const HybridQ& other)
+{
+  if (other.big_) {
+    set(*other.big_);
+  } else {
+    num_ = other.num_;
+    den_ = other.den_;
+    big_.reset();
+  }
+  return *this;
+}
+
+void HybridQ::set(const mpq_class& x)
+{
+  if (fits_small(x.get_num()) && fits_small(x.get_den())) {
+    num_ = x.get_num().get_si();
+    den_ = x.get_den().get_si();
+    big_.reset();
+  } else if (big_) {
+    *big_ = x;
+  } else {
+    big_.reset(new mpq_class(x));
+  }
+}
+
+void HybridQ::set_small(std::int64_t num, std::int64_t den)
+{
+  if (den < 0) {
+    num = -num;
+    den = -den;
+  }
+
+  std::int64_t divisor =
+      static_cast<std::int64_t>(gcd(abs_u(num), static_cast<std::uint64_t>(den)));
+  num_ = num / divisor;
+  den_ = den / divisor;
+  big_.reset();
+}
+
+mpq_class HybridQ::get_mpq() const
+{
+  if (big_) return *big_;
+
+  return mpq_class(mpz_class(static_cast<long>(num_)),
+                   mpz_class(static_cast<long>(den_)));
+}
+
+HybridQ HybridQ::operator-() const
+{
+  HybridQ result;
+  if (big_)
+    result.set(-*big_);
+  else {
+    result.num_ = -num_;
+    result.den_ = den_;
+  }
+  return result;
+}
+
+HybridQ& HybridQ::operator+=(const HybridQ& other)
+{
+  if (!big_ && !other.big_) {
+    std::int64_t num, den, a, b;
+
+    if (den_ == other.den_) {
+      if (add_checked(num_, other.num_, num)) {
+        set_small(num, den_);
+        return *this;
+      }
+    } else if (mul_checked(num_, other.den_, a) &&
+               mul_checked(other.num_, den_, b) && add_checked(a, b, num) &&
+               mul_checked(den_, other.den_, den)) {
+      set_small(num, den);
+      return *this;
+    }
+  }
+
+  set(get_mpq() + other.get_mpq());
+  return *this;
+}
+
+HybridQ& HybridQ::operator-=(const HybridQ& other)
+{
+  return *this += -other;
+}
+
+HybridQ& HybridQ::operator*=(const HybridQ& other)
+{
+  if (!big_ && !other.big_) {
+    std::int64_t g1 = static_cast<std::int64_t>(
+        gcd(abs_u(num_), static_cast<std::uint64_t>(other.den_)));
+    std::int64_t g2 = static_cast<std::int64_t>(
+        gcd(abs_u(other.num_), static_cast<std::uint64_t>(den_)));
+    std::int64_t num, den;
+
+    if (mul_checked(num_ / g1, other.num_ / g2, num) &&
+        mul_checked(den_ / g2, other.den_ / g1, den)) {
+      set_small(num, den);
+      return *this;
+    }
+  }
+
+  set(get_mpq() * other.get_mpq());
+  return *this;
+}
+
+HybridQ& HybridQ::operator/=(const HybridQ& other)
+{
+  if (!other) throw std::logic_error("HybridQ::operator/=: division by zero");
+
+  if (!big_ && !other.big_) {
+    std::int64_t g1 =
+        static_cast<std::int64_t>(gcd(abs_u(num_), abs_u(other.num_)));
+    std::int64_t g2 = static_cast<std::int64_t>(
+        gcd(static_cast<std::uint64_t>(den_),
+            static_cast<std::uint64_t>(other.den_)));
+    std::int64_t num, den;
+
+    if (mul_checked(num_ / g1, other.den_ / g2, num) &&
+        mul_checked(den_ / g2, other.num_ / g1, den)) {
+      set_small(num, den);
+      return *this;
+    }
+  }
+
+  set(get_mpq() / other.get_mpq());
+  return *this;
+}
+
+HybridQ operator+(HybridQ a, const HybridQ& b)
+{
+  return a += b;
+}
+
+HybridQ operator-(HybridQ a, const HybridQ& b)
+{
+  return a -= b;
+}
+
+HybridQ operator*(HybridQ a, const HybridQ& b)
+{
+  return a *= b;
+}
+
+HybridQ operator/(HybridQ a, const HybridQ& b)
+{
+  return a /= b;
+}
+
+bool operator==(const HybridQ& a, const HybridQ& b)
+{
+  if (!a.big_ && !b.big_) return a.num_ == b.num_ && a.den_ == b.den_;
+
+  return a.get_mpq() == b.get_mpq();
+}
+
+bool operator!=(const HybridQ& a, const HybridQ& b)
+{
+  return !(a == b);
+}
+
+std::ostream& operator<<(std::ostream& stream, const HybridQ& x)
+{
+  return stream << x.get_mpq();
+}
+
+val_t p_val_q(const mod_t p, const HybridQ& x)
+{
+  if (x.big_) return p_val_q(p, *x.big_);
+  if (x.num_ == 0) return std::numeric_limits<val_t>::max();
+
+  val_t num_valuation = p_val_u(p, abs_u(x.num_));
+
+  if (num_valuation > 0)
+    return num_valuation;
+  else
+    return -p_val_u(p, static_cast<std::uint64_t>(x.den_));
+}
+
+val_t p_val_q(const Prime<2> p, const HybridQ& x)
+{
+  if (x.big_) return p_val_q(p, *x.big_);
+  if (x.num_ == 0) return std::numeric_limits<val_t>::max();
+
+  // the denominator is odd whenever the numerator is even.
+  if (x.num_ % 2 == 0) return __builtin_ctzll(abs_u(x.num_));
+  return -__builtin_ctzll(static_cast<std::uint64_t>(x.den_));
+}
+
+Matrix<HybridQ> to_hybrid_q(const MatrixQ& f)
+{
+  return matrix_cast<HybridQ>(f);
+}
+
+MatrixQ to_rational(const Matrix<HybridQ>& f)
+{
+  MatrixQ result(f.height(), f.width());
+  for (dim_t i = 0; i < f.height(); ++i) {
+    for (dim_t j = 0; j < f.width(); ++j) {
+      result(i, j) = f(i, j).get_mpq();
+    }
+  }
+  return result;
+}
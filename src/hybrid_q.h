@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+
+#include <gmpxx.h>
+
+#include "matrix.h"
+#include "p_local.h"
+#include "types.h"
+
+// A rational number that is stored as a reduced fraction of two 64 bit
+// integers as long as numerator and denominator fit, and as an mpq_class
+// otherwise. Results that fit into 64 bits again are demoted, so arithmetic
+// on small entries never touches the heap.
+class HybridQ
+{
+ public:
+  HybridQ() = default;
+  HybridQ(const int x);
+  explicit HybridQ(const mpz_class& x);
+  explicit HybridQ(const mpq_class& x);
+
+  HybridQ(const HybridQ& other);
+  HybridQ& operator=(const HybridQ& other);
+  HybridQ(HybridQ&& other) = default;
+  HybridQ& operator=(HybridQ&& other) = default;
+
+  explicit operator bool() const
+  {
+    return big_ || num_ != 0;
+  }
+
+  inline bool is_small() const
+  {
+    return !big_;
+  }
+
+  mpq_class get_mpq() const;
+
+  HybridQ operator-() const;
+  HybridQ& operator+=(const HybridQ& other);
+  HybridQ& operator-=(const HybridQ& other);
+  HybridQ& operator*=(const HybridQ& other);
+  HybridQ& operator/=(const HybridQ& other);
+
+  friend bool operator==(const HybridQ& a, const HybridQ& b);
+  friend val_t p_val_q(const mod_t p, const HybridQ& x);
+  friend val_t p_val_q(const Prime<2> p, const HybridQ& x);
+
+ private:
+  void set(const mpq_class& x);
+  void set_small(std::int64_t num, std::int64_t den);
+
+  // only meaningful if big_ is not set. Then den_ > 0 and gcd(num_, den_) = 1.
+  std::int64_t num_ = 0;
+  std::int64_t den_ = 1;
+  std::unique_ptr<mpq_class> big_;
+};
+
+HybridQ operator+(HybridQ a, const HybridQ& b);
+HybridQ operator-(HybridQ a, const HybridQ& b);
+HybridQ operator*(HybridQ a, const HybridQ& b);
+HybridQ operator/(HybridQ a, const HybridQ& b);
+bool operator==(const HybridQ& a, const HybridQ& b);
+bool operator!=(const HybridQ& a, const HybridQ& b);
+std::ostream& operator<<(std::ostream& stream, const HybridQ& x);
+
+val_t p_val_q(const mod_t p, const HybridQ& x);
+val_t p_val_q(const Prime<2> p, const HybridQ& x);
+
+Matrix<HybridQ> to_hybrid_q(const MatrixQ& f);
+MatrixQ to_rational(const Matrix<HybridQ>& f);
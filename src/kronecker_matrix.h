@@ -0,0 +1,53 @@
+#pragma once
+
+#include <gmpxx.h>
+
+#include "matrix.h"
+#include "sparse_matrix.h"
+#include "types.h"
+
+// The Kronecker product A \otimes B of two sparse matrices, evaluated lazily:
+// entry (i, j) is A(i / B.height(), j / B.width()) *
+// B(i % B.height(), j % B.width()). Products with dense matrices run over the
+// nonzero entries of A and B, so the product itself is never stored.
+template <typename T>
+class KroneckerMatrix : public MatrixExpression<T, KroneckerMatrix>
+{
+ public:
+  KroneckerMatrix(SparseMatrix<T> left, SparseMatrix<T> right);
+
+  inline dim_t height() const
+  {
+    return left_.height() * right_.height();
+  }
+
+  inline dim_t width() const
+  {
+    return left_.width() * right_.width();
+  }
+
+  T operator()(const dim_t i, const dim_t j) const;
+
+  inline const SparseMatrix<T>& left() const
+  {
+    return left_;
+  }
+
+  inline const SparseMatrix<T>& right() const
+  {
+    return right_;
+  }
+
+ private:
+  SparseMatrix<T> left_;
+  SparseMatrix<T> right_;
+};
+
+template <typename T>
+Matrix<T> operator*(const KroneckerMatrix<T>& k, const Matrix<T>& f);
+template <typename T>
+Matrix<T> operator*(const Matrix<T>& f, const KroneckerMatrix<T>& k);
+
+using KroneckerMatrixQ = KroneckerMatrix<mpq_class>;
+
+#include "kronecker_matrix_impl.h"
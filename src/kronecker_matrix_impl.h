@@ -0,0 +1,91 @@
+#include <exception>
+#include <string>
+#include <utility>
+
+template <typename T>
+KroneckerMatrix<T>::KroneckerMatrix(SparseMatrix<T> left,
+                                    SparseMatrix<T> right)
+    : left_(std::move(left)), right_(std::move(right))
+{
+}
+
+template <typename T>
+T KroneckerMatrix<T>::operator()(const dim_t i, const dim_t j) const
+{
+  const dim_t h = right_.height();
+  const dim_t w = right_.width();
+
+  T a = left_(i / h, j / w);
+  if (!a) return a;
+  return a * right_(i % h, j % w);
+}
+
+// row (a_i, b_i) of (A \otimes B) f is the sum of A(a_i, a_k) B(b_i, b_k)
+// times row (a_k, b_k) of f.
+template <typename T>
+Matrix<T> operator*(const KroneckerMatrix<T>& k, const Matrix<T>& f)
+{
+  if (k.width() != f.height())
+    throw std::logic_error("KroneckerMatrix<T>::operator*: Dimension mismatch" +
+                           std::to_string(k.width()) + " != " +
+                           std::to_string(f.height()));
+
+  const SparseMatrix<T>& A = k.left();
+  const SparseMatrix<T>& B = k.right();
+
+  Matrix<T> kf(k.height(), f.width());
+  T factor;
+  for (dim_t a_i = 0; a_i < A.height(); ++a_i) {
+    for (dim_t a = A.row_begin(a_i); a < A.row_end(a_i); ++a) {
+      for (dim_t b_i = 0; b_i < B.height(); ++b_i) {
+        const dim_t i = a_i * B.height() + b_i;
+
+        for (dim_t b = B.row_begin(b_i); b < B.row_end(b_i); ++b) {
+          const dim_t row = A.column(a) * B.width() + B.column(b);
+          factor = A.value(a) * B.value(b);
+
+          for (dim_t j = 0; j < f.width(); ++j) {
+            mul_add(kf(i, j), factor, f(row, j));
+          }
+        }
+      }
+    }
+  }
+
+  return kf;
+}
+
+// column (a_j, b_j) of f (A \otimes B) is the sum of A(a_k, a_j) B(b_k, b_j)
+// times column (a_k, b_k) of f.
+template <typename T>
+Matrix<T> operator*(const Matrix<T>& f, const KroneckerMatrix<T>& k)
+{
+  if (f.width() != k.height())
+    throw std::logic_error("KroneckerMatrix<T>::operator*: Dimension mismatch" +
+                           std::to_string(f.width()) + " != " +
+                           std::to_string(k.height()));
+
+  const SparseMatrix<T>& A = k.left();
+  const SparseMatrix<T>& B = k.right();
+
+  Matrix<T> fk(f.height(), k.width());
+  T factor;
+  for (dim_t a_k = 0; a_k < A.height(); ++a_k) {
+    for (dim_t a = A.row_begin(a_k); a < A.row_end(a_k); ++a) {
+      for (dim_t b_k = 0; b_k < B.height(); ++b_k) {
+        const dim_t column = a_k * B.height() + b_k;
+
+        for (dim_t b = B.row_begin(b_k); b < B.row_end(b_k); ++b) {
+          const dim_t j = A.column(a) * B.width() + B.column(b);
+          factor = A.value(a) * B.value(b);
+
+          for (dim_t i = 0; i < f.height(); ++i) {
+            mul_add(fk(i, j), f(i, column), factor);
+          }
+        }
+      }
+    }
+  }
+
+  return fk;
+}
@@ -11,6 +11,15 @@
 
 #include "types.h"
 
+// the type the entries of an expression E are read as through
+// MatrixExpression<T, E>::operator() const. Expressions that store their
+// entries specialize it to const T&, so that reading does not copy.
+template <typename T, template <typename> class E>
+struct MatrixEntry
+{
+  using type = T;
+};
+
 template <typename T, template <typename> class E>
 class MatrixExpression
 {
@@ -30,7 +39,8 @@ class MatrixExpression
     return static_cast<const E<T>&>(*this).width();
   }
 
-  inline T operator()(const dim_t i, const dim_t j) const
+  inline typename MatrixEntry<T, E>::type operator()(const dim_t i,
+                                                    const dim_t j) const
   {
     return static_cast<const E<T>&> (*this)(i, j);
   }
@@ -67,15 +77,62 @@ class IdentityMatrix : public MatrixExpression<T, IdentityMatrix>
   dim_t n_;
 };
 
+// size entries of a matrix that are stride apart in memory, such as a row or
+// a column. Valid as long as the matrix is not resized.
+template <typename T>
+class MatrixVector
+{
+ public:
+  MatrixVector(T* data, const dim_t size, const dim_t stride)
+      : data_(data), size_(size), stride_(stride)
+  {
+  }
+
+  inline dim_t size() const
+  {
+    return size_;
+  }
+
+  inline T& operator[](const dim_t k) const
+  {
+    return data_[k * stride_];
+  }
+
+ private:
+  T* data_;
+  dim_t size_;
+  dim_t stride_;
+};
+
+// the order in which a Matrix stores its entries. Row operations sweep
+// contiguous memory in row-major matrices, column operations in column-major
+// ones.
+enum class Layout { row_major, column_major };
+
+template <typename T>
+class Matrix;
 template <typename T>
 class MatrixSlice;
 
+template <typename T>
+struct MatrixEntry<T, Matrix>
+{
+  using type = const T&;
+};
+
+template <typename T>
+struct MatrixEntry<T, MatrixSlice>
+{
+  using type = const T&;
+};
+
 template <typename T>
 class Matrix : public MatrixExpression<T, Matrix>
 {
  public:
   Matrix() = default;
-  Matrix(const dim_t height, const dim_t width);
+  Matrix(const dim_t height, const dim_t width,
+         const Layout layout = Layout::row_major);
   Matrix(std::initializer_list<std::initializer_list<T>> lst);
   Matrix(dim_t height, dim_t width, std::vector<T> entries);
   Matrix(const Matrix<T>& other) = default;
@@ -96,12 +153,25 @@ class Matrix : public MatrixExpression<T, Matrix>
     return width_;
   }
 
-  T operator()(const dim_t i, const dim_t j) const;
+  inline Layout layout() const
+  {
+    return layout_;
+  }
+
+  // reorders the entries for the given layout.
+  void set_layout(const Layout layout);
+
+  const T& operator()(const dim_t i, const dim_t j) const;
   T& operator()(const dim_t i, const dim_t j);
 
   MatrixSlice<T> operator()(const dim_t i, const dim_t j,
                             const dim_t height, const dim_t width);
 
+  MatrixVector<const T> row(const dim_t i) const;
+  MatrixVector<T> row(const dim_t i);
+  MatrixVector<const T> col(const dim_t j) const;
+  MatrixVector<T> col(const dim_t j);
+
   static IdentityMatrix<T> identity(const dim_t n);
 
   Matrix<T>& row_add(const dim_t i1, const dim_t i2,
@@ -114,9 +184,23 @@ class Matrix : public MatrixExpression<T, Matrix>
   Matrix<T>& col_mul(const dim_t j, const T& lambda);
   Matrix<T>& col_swap(const dim_t j1, const dim_t j2);
 
+  template <typename S>
+  friend Matrix<S> operator*(const Matrix<S>& g, const Matrix<S>& f);
+
  private:
-  dim_t height_;
-  dim_t width_;
+  inline dim_t index(const dim_t i, const dim_t j) const
+  {
+    return i * row_stride_ + j * col_stride_;
+  }
+
+  void set_strides();
+
+  dim_t height_ = 0;
+  dim_t width_ = 0;
+  Layout layout_ = Layout::row_major;
+  // entry (i, j) is entries_[i * row_stride_ + j * col_stride_].
+  dim_t row_stride_ = 0;
+  dim_t col_stride_ = 1;
   std::vector<T> entries_;
 };
 
@@ -143,7 +227,7 @@ class MatrixSlice : public MatrixExpression<T, MatrixSlice>
     return width_;
   }
 
-  T operator()(const dim_t i, const dim_t j) const;
+  const T& operator()(const dim_t i, const dim_t j) const;
   T& operator()(const dim_t i, const dim_t j);
 
  private:
@@ -172,10 +256,26 @@ template <typename T>
 void basis_vectors_swap(MatrixRefList<T>& to_X, MatrixRefList<T>& from_X,
                         const dim_t i1, const dim_t i2);
 
+// acc += a * b, without a temporary for the product where T allows it.
+template <typename T>
+void mul_add(T& acc, const T& a, const T& b);
+inline void mul_add(mpz_class& acc, const mpz_class& a, const mpz_class& b);
+inline void mul_add(mpq_class& acc, const mpq_class& a, const mpq_class& b);
+
+// gf, computed in tiles, with blocks of rows of gf distributed over the
+// threads of parallel_for.
+template <typename T>
+Matrix<T> operator*(const Matrix<T>& g, const Matrix<T>& f);
+
 using MatrixQ = Matrix<mpq_class>;
 using MatrixQList = MatrixList<mpq_class>;
 using MatrixQRefList = MatrixRefList<mpq_class>;
 
+// converts the entries of f to S, which has to be explicitly constructible
+// from T.
+template <typename S, typename T>
+Matrix<S> matrix_cast(const Matrix<T>& f);
+
 template <typename T>
 MatrixList<T> deref(const MatrixRefList<T>& ref_list);
 template <typename T>
@@ -1,3 +1,7 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
 template <typename T, template <typename> class E>
 MatrixExpression<T, E>::MatrixExpression(const MatrixExpression<T, E>&)
 {
@@ -54,15 +58,18 @@ T IdentityMatrix<T>::operator()(const dim_t i, const dim_t j) const
 }
 
 template <typename T>
-Matrix<T>::Matrix(const dim_t height, const dim_t width)
-    : height_(height), width_(width), entries_(height_ * width_)
+Matrix<T>::Matrix(const dim_t height, const dim_t width, const Layout layout)
+    : height_(height), width_(width), layout_(layout),
+      entries_(height_ * width_)
 {
+  set_strides();
 }
 
 template <typename T>
 Matrix<T>::Matrix(std::initializer_list<std::initializer_list<T>> lst)
     : height_(lst.size()), width_(height_ ? lst.begin()->size() : 0)
 {
+  set_strides();
   entries_.reserve(height_ * width_);
 
   for (const auto& row : lst) {
@@ -76,6 +83,7 @@ template <typename T>
 Matrix<T>::Matrix(dim_t height, dim_t width, std::vector<T> entries)
     : height_(height), width_(width)
 {
+  set_strides();
   entries_.reserve(height_ * width_);
 
   for (const T& value : entries) {
@@ -88,6 +96,7 @@ template <template <typename> class E>
 Matrix<T>::Matrix(const MatrixExpression<T, E>&& expr)
     : height_(expr.height()), width_(expr.width())
 {
+  set_strides();
   entries_.reserve(height_ * width_);
 
   for (dim_t i = 0; i < height_; ++i) {
@@ -102,20 +111,50 @@ Matrix<T>& Matrix<T>::operator=(const Matrix<T>& other)
 {
   height_ = other.height_;
   width_ = other.width_;
+  layout_ = other.layout_;
+  row_stride_ = other.row_stride_;
+  col_stride_ = other.col_stride_;
   entries_ = other.entries_;
   return *this;
 }
 
 template <typename T>
-T Matrix<T>::operator()(const dim_t i, const dim_t j) const
+void Matrix<T>::set_strides()
 {
-  return entries_[i * width_ + j];
+  row_stride_ = layout_ == Layout::row_major ? width_ : 1;
+  col_stride_ = layout_ == Layout::row_major ? 1 : height_;
+}
+
+template <typename T>
+void Matrix<T>::set_layout(const Layout layout)
+{
+  if (layout == layout_) return;
+
+  std::vector<T> entries(entries_.size());
+  const dim_t row_stride = layout == Layout::row_major ? width_ : 1;
+  const dim_t col_stride = layout == Layout::row_major ? 1 : height_;
+  for (dim_t i = 0; i < height_; ++i) {
+    for (dim_t j = 0; j < width_; ++j) {
+      using std::swap;
+      swap(entries[i * row_stride + j * col_stride], entries_[index(i, j)]);
+    }
+  }
+
+  entries_.swap(entries);
+  layout_ = layout;
+  set_strides();
+}
+
+template <typename T>
+const T& Matrix<T>::operator()(const dim_t i, const dim_t j) const
+{
+  return entries_[index(i, j)];
 }
 
 template <typename T>
 T& Matrix<T>::operator()(const dim_t i, const dim_t j)
 {
-  return entries_[i * width_ + j];
+  return entries_[index(i, j)];
 }
 
 template <typename T>
@@ -126,6 +165,32 @@ MatrixSlice<T> Matrix<T>::operator()(const dim_t i, const dim_t j,
   return MatrixSlice<T>(*this, i, j, height, width);
 }
 
+template <typename T>
+MatrixVector<const T> Matrix<T>::row(const dim_t i) const
+{
+  return MatrixVector<const T>(entries_.data() + index(i, 0), width_,
+                               col_stride_);
+}
+
+template <typename T>
+MatrixVector<T> Matrix<T>::row(const dim_t i)
+{
+  return MatrixVector<T>(entries_.data() + index(i, 0), width_, col_stride_);
+}
+
+template <typename T>
+MatrixVector<const T> Matrix<T>::col(const dim_t j) const
+{
+  return MatrixVector<const T>(entries_.data() + index(0, j), height_,
+                               row_stride_);
+}
+
+template <typename T>
+MatrixVector<T> Matrix<T>::col(const dim_t j)
+{
+  return MatrixVector<T>(entries_.data() + index(0, j), height_, row_stride_);
+}
+
 template <typename T>
 IdentityMatrix<T> Matrix<T>::identity(const dim_t n)
 {
@@ -137,7 +202,7 @@ Matrix<T>& Matrix<T>::row_add(const dim_t i1, const dim_t i2,
                               const T& lambda)
 {
   for (dim_t j = 0; j < width_; ++j) {
-    entries_[i2 * width_ + j] += lambda * entries_[i1 * width_ + j];
+    mul_add(entries_[index(i2, j)], lambda, entries_[index(i1, j)]);
   }
   return *this;
 }
@@ -146,7 +211,7 @@ template <typename T>
 Matrix<T>& Matrix<T>::row_mul(const dim_t i, const T& lambda)
 {
   for (dim_t j = 0; j < width_; ++j) {
-    entries_[i * width_ + j] *= lambda;
+    entries_[index(i, j)] *= lambda;
   }
   return *this;
 }
@@ -157,7 +222,7 @@ Matrix<T>& Matrix<T>::row_swap(const dim_t i1, const dim_t i2)
   using std::swap;
 
   for (dim_t j = 0; j < width_; ++j) {
-    swap(entries_[i1 * width_ + j], entries_[i2 * width_ + j]);
+    swap(entries_[index(i1, j)], entries_[index(i2, j)]);
   }
   return *this;
 }
@@ -167,7 +232,7 @@ Matrix<T>& Matrix<T>::col_add(const dim_t j1, const dim_t j2,
                               const T& lambda)
 {
   for (dim_t i = 0; i < height_; ++i) {
-    entries_[i * width_ + j2] += lambda * entries_[i * width_ + j1];
+    mul_add(entries_[index(i, j2)], lambda, entries_[index(i, j1)]);
   }
   return *this;
 }
@@ -176,7 +241,7 @@ template <typename T>
 Matrix<T>& Matrix<T>::col_mul(const dim_t j, const T& lambda)
 {
   for (dim_t i = 0; i < height_; ++i) {
-    entries_[i * width_ + j] *= lambda;
+    entries_[index(i, j)] *= lambda;
   }
   return *this;
 }
@@ -187,7 +252,7 @@ Matrix<T>& Matrix<T>::col_swap(const dim_t j1, const dim_t j2)
   using std::swap;
 
   for (dim_t i = 0; i < height_; ++i) {
-    swap(entries_[i * width_ + j1], entries_[i * width_ + j2]);
+    swap(entries_[index(i, j1)], entries_[index(i, j2)]);
   }
   return *this;
 }
@@ -236,7 +301,7 @@ MatrixSlice<T>& MatrixSlice<T>::operator=(const MatrixExpression<T, E>& expr)
 }
 
 template <typename T>
-T MatrixSlice<T>::operator()(const dim_t i, const dim_t j) const
+const T& MatrixSlice<T>::operator()(const dim_t i, const dim_t j) const
 {
   return mat_(i_ + i, j_ + j);
 }
@@ -247,6 +312,31 @@ T& MatrixSlice<T>::operator()(const dim_t i, const dim_t j)
   return mat_(i_ + i, j_ + j);
 }
 
+template <typename T>
+void mul_add(T& acc, const T& a, const T& b)
+{
+  acc += a * b;
+}
+
+inline void mul_add(mpz_class& acc, const mpz_class& a, const mpz_class& b)
+{
+  mpz_addmul(acc.get_mpz_t(), a.get_mpz_t(), b.get_mpz_t());
+}
+
+inline void mul_add(mpq_class& acc, const mpq_class& a, const mpq_class& b)
+{
+  static thread_local mpq_class product;
+  mpq_mul(product.get_mpq_t(), a.get_mpq_t(), b.get_mpq_t());
+  mpq_add(acc.get_mpq_t(), acc.get_mpq_t(), product.get_mpq_t());
+}
+
+// operator* hands out blocks of product_row_block rows to the threads, and
+// tiles the inner dimension and the columns by product_tile_size. Below
+// product_parallel_threshold scalar multiplications it runs serially.
+const dim_t product_row_block = 8;
+const dim_t product_tile_size = 32;
+const dim_t product_parallel_threshold = 1 << 15;
+
 template <typename T>
 Matrix<T> operator*(const Matrix<T>& g, const Matrix<T>& f)
 {
@@ -255,17 +345,45 @@ Matrix<T> operator*(const Matrix<T>& g, const Matrix<T>& f)
                            std::to_string(g.width()) + " != " +
                            std::to_string(f.height()));
 
-  Matrix<T> gf(g.height(), f.width());
-  for (dim_t i = 0; i < g.height(); ++i) {
-    for (dim_t j = 0; j < f.width(); ++j) {
-      T acc;
-
-      for (dim_t k = 0; k < g.width(); ++k) {
-        acc += g(i, k) * f(k, j);
+  const dim_t height = g.height();
+  const dim_t inner = g.width();
+  const dim_t width = f.width();
+  Matrix<T> gf(height, width);
+
+  // every entry of gf is accumulated by a single thread, in increasing order
+  // of k, so the result does not depend on the number of threads.
+  auto multiply_rows = [&](const dim_t block) {
+    const dim_t i_begin = block * product_row_block;
+    const dim_t i_end = std::min(i_begin + product_row_block, height);
+
+    for (dim_t k_begin = 0; k_begin < inner; k_begin += product_tile_size) {
+      const dim_t k_end = std::min(k_begin + product_tile_size, inner);
+
+      for (dim_t j_begin = 0; j_begin < width; j_begin += product_tile_size) {
+        const dim_t j_end = std::min(j_begin + product_tile_size, width);
+
+        for (dim_t i = i_begin; i < i_end; ++i) {
+          for (dim_t k = k_begin; k < k_end; ++k) {
+            const T& a = g.entries_[g.index(i, k)];
+            if (!a) continue;
+
+            for (dim_t j = j_begin; j < j_end; ++j) {
+              mul_add(gf.entries_[gf.index(i, j)], a,
+                      f.entries_[f.index(k, j)]);
+            }
+          }
+        }
       }
+    }
+  };
 
-      gf(i, j) = acc;
+  const dim_t blocks = (height + product_row_block - 1) / product_row_block;
+  if (height * inner * width < product_parallel_threshold) {
+    for (dim_t block = 0; block < blocks; ++block) {
+      multiply_rows(block);
     }
+  } else {
+    parallel_for(0, blocks, multiply_rows);
   }
 
   return gf;
@@ -327,6 +445,18 @@ void basis_vectors_swap(MatrixRefList<T>& to_X, MatrixRefList<T>& from_X,
   }
 }
 
+template <typename S, typename T>
+Matrix<S> matrix_cast(const Matrix<T>& f)
+{
+  Matrix<S> result(f.height(), f.width());
+  for (dim_t i = 0; i < f.height(); ++i) {
+    for (dim_t j = 0; j < f.width(); ++j) {
+      result(i, j) = S(f(i, j));
+    }
+  }
+  return result;
+}
+
 template <typename T>
 MatrixList<T> deref(const MatrixRefList<T>& ref_list)
 {
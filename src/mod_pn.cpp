@@ -0,0 +1,253 @@
+#include "mod_pn.h"
+
+#include <exception>
+#include <limits>
+
+mod_t ModPN::prime_ = 0;
+u_val_t ModPN::precision_ = 0;
+std::uint64_t ModPN::modulus_ = 0;
+
+namespace {
+
+std::recursive_mutex& context_mutex()
+{
+  static std::recursive_mutex mutex;
+  return mutex;
+}
+
+}  // namespace
+
+ModPN::Context::Context(const mod_t p, const u_val_t precision)
+    : lock_(context_mutex()),
+      prev_prime_(prime_),
+      prev_precision_(precision_),
+      prev_modulus_(modulus_)
+{
+  if (p < 2) throw std::logic_error("ModPN::Context: invalid prime");
+  if (precision == 0 || precision > max_precision(p))
+    throw std::logic_error(
+        "ModPN::Context: p^N does not fit into 32 bits (N=" +
+        std::to_string(precision) + ")");
+
+  std::uint64_t modulus = 1;
+  for (u_val_t i = 0; i < precision; ++i) {
+    modulus *= p;
+  }
+
+  prime_ = p;
+  precision_ = precision;
+  modulus_ = modulus;
+}
+
+ModPN::Context::~Context()
+{
+  prime_ = prev_prime_;
+  precision_ = prev_precision_;
+  modulus_ = prev_modulus_;
+}
+
+ModPN::ModPN(const int x)
+{
+  if (modulus_ == 0) throw std::logic_error("ModPN::ModPN: no modulus set");
+
+  std::int64_t remainder = x % static_cast<std::int64_t>(modulus_);
+  if (remainder < 0) remainder += static_cast<std::int64_t>(modulus_);
+  value_ = static_cast<std::uint64_t>(remainder);
+}
+
+ModPN::ModPN(const mpz_class& x)
+{
+  if (modulus_ == 0) throw std::logic_error("ModPN::ModPN: no modulus set");
+
+  value_ = mpz_fdiv_ui(x.get_mpz_t(), modulus_);
+}
+
+ModPN::ModPN(const mpq_class& x)
+{
+  if (modulus_ == 0) throw std::logic_error("ModPN::ModPN: no modulus set");
+  if (mpz_divisible_ui_p(x.get_den_mpz_t(), prime_))
+    throw std::logic_error("ModPN::ModPN: denominator is divisible by p");
+
+  std::uint64_t num = mpz_fdiv_ui(x.get_num_mpz_t(), modulus_);
+  std::uint64_t den = mpz_fdiv_ui(x.get_den_mpz_t(), modulus_);
+  value_ = num * inverse(den, modulus_) % modulus_;
+}
+
+mod_t ModPN::prime()
+{
+  return prime_;
+}
+
+u_val_t ModPN::precision()
+{
+  return precision_;
+}
+
+std::uint64_t ModPN::modulus()
+{
+  return modulus_;
+}
+
+u_val_t ModPN::max_precision(const mod_t p)
+{
+  const std::uint64_t bound = std::numeric_limits<std::uint32_t>::max();
+
+  u_val_t precision = 0;
+  for (std::uint64_t pow = p; pow <= bound; pow *= p) {
+    ++precision;
+  }
+  return precision;
+}
+
+mpz_class ModPN::get_mpz() const
+{
+  mpz_class result(static_cast<unsigned long>(value_));
+  if (value_ > modulus_ / 2) result -= static_cast<unsigned long>(modulus_);
+  return result;
+}
+
+val_t ModPN::valuation() const
+{
+  if (value_ == 0) return std::numeric_limits<val_t>::max();
+
+  val_t val = 0;
+  for (std::uint64_t x = value_; x % prime_ == 0; x /= prime_) {
+    ++val;
+  }
+  return val;
+}
+
+ModPN ModPN::operator-() const
+{
+  ModPN result;
+  result.value_ = value_ == 0 ? 0 : modulus_ - value_;
+  return result;
+}
+
+ModPN& ModPN::operator+=(const ModPN& other)
+{
+  value_ = (value_ + other.value_) % modulus_;
+  return *this;
+}
+
+ModPN& ModPN::operator-=(const ModPN& other)
+{
+  value_ = (value_ + modulus_ - other.value_) % modulus_;
+  return *this;
+}
+
+ModPN& ModPN::operator*=(const ModPN& other)
+{
+  value_ = value_ * other.value_ % modulus_;
+  return *this;
+}
+
+ModPN& ModPN::operator/=(const ModPN& other)
+{
+  if (!other) throw std::logic_error("ModPN::operator/=: division by zero");
+
+  std::uint64_t dividend = value_;
+  std::uint64_t divisor = other.value_;
+  std::uint64_t modulus = modulus_;
+
+  while (divisor % prime_ == 0) {
+    if (dividend % prime_ != 0)
+      throw std::logic_error(
+          "ModPN::operator/=: divisor has larger valuation than dividend");
+    dividend /= prime_;
+    divisor /= prime_;
+    modulus /= prime_;
+  }
+
+  value_ = dividend % modulus * inverse(divisor % modulus, modulus) % modulus;
+  return *this;
+}
+
+std::uint64_t ModPN::inverse(const std::uint64_t unit,
+                             const std::uint64_t modulus)
+{
+  std::int64_t t = 0;
+  std::int64_t new_t = 1;
+  std::int64_t r = static_cast<std::int64_t>(modulus);
+  std::int64_t new_r = static_cast<std::int64_t>(unit % modulus);
+
+  while (new_r != 0) {
+    std::int64_t quotient = r / new_r;
+    std::int64_t tmp = t - quotient * new_t;
+    t = new_t;
+    new_t = tmp;
+    tmp = r - quotient * new_r;
+    r = new_r;
+    new_r = tmp;
+  }
+
+  if (r != 1) throw std::logic_error("ModPN::inverse: element is not a unit");
+  if (t < 0) t += static_cast<std::int64_t>(modulus);
+  return static_cast<std::uint64_t>(t);
+}
+
+ModPN operator+(ModPN a, const ModPN& b)
+{
+  return a += b;
+}
+
+ModPN operator-(ModPN a, const ModPN& b)
+{
+  return a -= b;
+}
+
+ModPN operator*(ModPN a, const ModPN& b)
+{
+  return a *= b;
+}
+
+ModPN operator/(ModPN a, const ModPN& b)
+{
+  return a /= b;
+}
+
+bool operator==(const ModPN& a, const ModPN& b)
+{
+  return a.value_ == b.value_;
+}
+
+bool operator!=(const ModPN& a, const ModPN& b)
+{
+  return !(a == b);
+}
+
+std::ostream& operator<<(std::ostream& stream, const ModPN& x)
+{
+  return stream << x.get_mpz();
+}
+
+val_t p_val_q(const mod_t p, const ModPN& x)
+{
+  if (p != ModPN::prime())
+    throw std::logic_error("p_val_q: prime does not match ModPN::prime()");
+  return x.valuation();
+}
+
+val_t p_val_q(const Prime<2>, const ModPN& x)
+{
+  if (ModPN::prime() != 2)
+    throw std::logic_error("p_val_q: prime does not match ModPN::prime()");
+  if (!x) return std::numeric_limits<val_t>::max();
+  return __builtin_ctzll(x.get_ui());
+}
+
+Matrix<ModPN> to_mod_pn(const MatrixQ& f)
+{
+  return matrix_cast<ModPN>(f);
+}
+
+MatrixQ to_rational(const Matrix<ModPN>& f)
+{
+  MatrixQ result(f.height(), f.width());
+  for (dim_t i = 0; i < f.height(); ++i) {
+    for (dim_t j = 0; j < f.width(); ++j) {
+      result(i, j) = f(i, j).get_mpz();
+    }
+  }
+  return result;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+
+#include <gmpxx.h>
+
+#include "matrix.h"
+#include "p_local.h"
+#include "types.h"
+
+// An element of Z/p^N, stored as its representative in [0, p^N).
+// The modulus is shared by all elements and is installed for the lifetime of
+// a ModPN::Context. p^N has to fit into 32 bits, so that the product of two
+// representatives fits into a single machine word.
+class ModPN
+{
+ public:
+  class Context
+  {
+   public:
+    Context(const mod_t p, const u_val_t precision);
+    ~Context();
+
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+
+   private:
+    // the modulus is shared by all threads, so a context on one thread
+    // waits for the contexts on the others to end.
+    std::unique_lock<std::recursive_mutex> lock_;
+    mod_t prev_prime_;
+    u_val_t prev_precision_;
+    std::uint64_t prev_modulus_;
+  };
+
+  ModPN() = default;
+  ModPN(const int x);
+  explicit ModPN(const mpz_class& x);
+  explicit ModPN(const mpq_class& x);
+
+  static mod_t prime();
+  static u_val_t precision();
+  static std::uint64_t modulus();
+
+  // the largest N such that p^N fits into 32 bits.
+  static u_val_t max_precision(const mod_t p);
+
+  explicit operator bool() const
+  {
+    return value_ != 0;
+  }
+
+  inline std::uint64_t get_ui() const
+  {
+    return value_;
+  }
+
+  // the representative of smallest absolute value.
+  mpz_class get_mpz() const;
+  val_t valuation() const;
+
+  ModPN operator-() const;
+  ModPN& operator+=(const ModPN& other);
+  ModPN& operator-=(const ModPN& other);
+  ModPN& operator*=(const ModPN& other);
+  // only defined if the valuation of other is at most the valuation of *this.
+  // The result is then determined modulo p^(N - valuation of other).
+  ModPN& operator/=(const ModPN& other);
+
+  friend bool operator==(const ModPN& a, const ModPN& b);
+
+ private:
+  static std::uint64_t inverse(const std::uint64_t unit,
+                               const std::uint64_t modulus);
+
+  static mod_t prime_;
+  static u_val_t precision_;
+  static std::uint64_t modulus_;
+
+  std::uint64_t value_ = 0;
+};
+
+ModPN operator+(ModPN a, const ModPN& b);
+ModPN operator-(ModPN a, const ModPN& b);
+ModPN operator*(ModPN a, const ModPN& b);
+ModPN operator/(ModPN a, const ModPN& b);
+bool operator==(const ModPN& a, const ModPN& b);
+bool operator!=(const ModPN& a, const ModPN& b);
+std::ostream& operator<<(std::ostream& stream, const ModPN& x);
+
+val_t p_val_q(const mod_t p, const ModPN& x);
+val_t p_val_q(const Prime<2> p, const ModPN& x);
+
+Matrix<ModPN> to_mod_pn(const MatrixQ& f);
+MatrixQ to_rational(const Matrix<ModPN>& f);
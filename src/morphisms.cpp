@@ -1,239 +1,456 @@
 #include "morphisms.h"
 
+#include <algorithm>
+#include <initializer_list>
 #include <iostream>
+#include <memory>
 
+#include "hybrid_q.h"
+#include "mod_pn.h"
 #include "p_local.h"
-#include "smith.h"
 
-GroupWithMorphisms::GroupWithMorphisms(const dim_t free_rank,
-                                       const dim_t tor_rank)
-    : group(free_rank, tor_rank)
+static Coefficients coefficients_ = Coefficients::rational;
+static u_val_t precision_margin_ = 8;
+
+void set_coefficients(const Coefficients coefficients,
+                      const u_val_t precision_margin)
 {
+  coefficients_ = coefficients;
+  precision_margin_ = precision_margin;
 }
 
-GroupWithMorphisms compute_cokernel(const mod_t p, const MatrixQ& f,
-                                    const AbelianGroup& Y,
-                                    const MatrixQRefList& to_Y_ref,
-                                    const MatrixQRefList& from_Y_ref)
+Coefficients get_coefficients()
 {
+  return coefficients_;
+}
 
-  MatrixQ f_rel_Y(f.height(), f.width() + Y.tor_rank());
-  f_rel_Y(0, 0, f.height(), f.width()) = f;
-  f_rel_Y(0, f.width(), Y.tor_rank(), Y.tor_rank()) = Y.torsion_matrix(p);
+CoefficientsScope::CoefficientsScope(const Coefficients coefficients,
+                                     const u_val_t precision_margin)
+    : prev_coefficients_(coefficients_),
+      prev_precision_margin_(precision_margin_)
+{
+  set_coefficients(coefficients, precision_margin);
+}
 
-  MatrixQList to_Y_copy = deref(to_Y_ref);
-  MatrixQList from_Y_copy = deref(from_Y_ref);
+CoefficientsScope::~CoefficientsScope()
+{
+  set_coefficients(prev_coefficients_, prev_precision_margin_);
+}
 
-  MatrixQRefList to_X;
-  MatrixQRefList from_X;
-  MatrixQRefList to_Y_copy_ref = ref(to_Y_copy);
-  MatrixQRefList from_Y_copy_ref = ref(from_Y_copy);
+// whether no nonzero entry of f has valuation precision or more, which
+// Z/p^precision would read as 0.
+static bool below_precision(const mod_t p, const MatrixQ& f,
+                            const u_val_t precision)
+{
+  for (dim_t i = 0; i < f.height(); ++i) {
+    for (dim_t j = 0; j < f.width(); ++j) {
+      const mpq_class& entry = f(i, j);
+      if (entry != 0 &&
+          p_val_q(p, entry) >= static_cast<val_t>(precision)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
 
-  smith_reduce_p(p, f_rel_Y, to_X, from_X, to_Y_copy_ref, from_Y_copy_ref);
+// returns the precision N to compute with in Z/p^N for maps between X and Y,
+// or 0 if the computation should be done over Q. Z/p^N only sees valuations
+// below N. If X and Y are torsion, their orders bound every valuation the
+// reduction needs, so N is the largest order plus a margin; a free summand
+// allows arbitrarily large valuations, so those are computed over Q. So are
+// f and the maps in lists with an entry that Z/p^N would read as 0.
+static u_val_t mod_p_power_precision(
+    const mod_t p, const AbelianGroup& X, const AbelianGroup& Y,
+    const MatrixQ& f,
+    std::initializer_list<const MatrixQRefList*> lists = {})
+{
+  if (coefficients_ != Coefficients::mod_p_power) return 0;
+  if (X.free_rank() > 0 || Y.free_rank() > 0) return 0;
 
-  dim_t rank_diff = 0;
-  dim_t torsion_rank = 0;
+  u_val_t precision =
+      std::max(X.max_order(), Y.max_order()) + precision_margin_;
+  if (precision == 0 || precision > ModPN::max_precision(p)) return 0;
 
-  for (dim_t i = 0; i < std::min(f_rel_Y.height(), f_rel_Y.width()); ++i) {
-    if (f_rel_Y(i, i) == 1)
-      ++rank_diff;
-    else if (f_rel_Y(i, i) != 0)
-      ++torsion_rank;
-    else
-      break;
+  if (!below_precision(p, f, precision)) return 0;
+  for (const MatrixQRefList* list : lists) {
+    for (const MatrixQ& g : *list) {
+      if (!below_precision(p, g, precision)) return 0;
+    }
   }
+  return precision;
+}
 
-  GroupWithMorphisms C(f_rel_Y.height() - rank_diff - torsion_rank,
-                       torsion_rank);
-  for (dim_t i = rank_diff; i < rank_diff + torsion_rank; ++i)
-    C.group(i - rank_diff) = static_cast<dim_t>(p_val_q(p, f_rel_Y(i, i)));
-
-  for (MatrixQ& g_to_Y : to_Y_copy)
-    C.maps_to.emplace_back(
-        g_to_Y(rank_diff, 0, g_to_Y.height() - rank_diff, g_to_Y.width()));
+template <typename T>
+static MatrixList<T> matrix_cast(const MatrixQRefList& list)
+{
+  MatrixList<T> result;
+  result.reserve(list.size());
 
-  for (MatrixQ& g_from_Y : from_Y_copy)
-    C.maps_from.emplace_back(g_from_Y(0, rank_diff, g_from_Y.height(),
-                                      g_from_Y.width() - rank_diff));
+  for (const MatrixQ& f : list) {
+    result.push_back(matrix_cast<T>(f));
+  }
 
-  return C;
+  return result;
 }
 
-GroupWithMorphisms compute_kernel(const mod_t p, const MatrixQ& f,
-                                  const AbelianGroup& X, const AbelianGroup& Y,
-                                  const MatrixQRefList& to_X_ref,
-                                  const MatrixQRefList& from_X_ref)
+template <typename T>
+static GroupWithMorphisms to_rational(const BasicGroupWithMorphisms<T>& G)
 {
-  MatrixQ f_rel_Y(f.height(), f.width() + Y.tor_rank());
-  f_rel_Y(0, 0, f.height(), f.width()) = f;
-  f_rel_Y(0, f.width(), Y.tor_rank(), Y.tor_rank()) = Y.torsion_matrix(p);
-
-  MatrixQ rel_x_lift(f.width() + Y.tor_rank(), X.tor_rank());
-  rel_x_lift(0, 0, X.tor_rank(), X.tor_rank()) = X.torsion_matrix(p);
-  // rel_x_lift(f.width(), 0, Y.tor_rank(), X.tor_rank()) = -lift of f\circ
-  // rel_x over rel_Y.
-  //      Can be computed by multiplying the columns of f with the orders of X,
-  //      and dividing the rows by the orders of Y.
-
-  for (dim_t i = 0; i < Y.tor_rank(); ++i) {
-    for (dim_t j = 0; j < X.tor_rank(); ++j) {
-      val_t order_diff = static_cast<val_t>(X(j) - Y(i));
-      rel_x_lift(f.width() + i, j) = -f(i, j) * p_pow_q(p, order_diff);
-    }
-  }
+  GroupWithMorphisms result;
+  result.group = G.group;
 
-  // build to_X_rel_Y, from_X_rel_Y.
-  MatrixQList to_X_rel_Y;
-  for (MatrixQ& g_to_X : to_X_ref) {
-    to_X_rel_Y.emplace_back(f.width() + Y.tor_rank(), g_to_X.width());
-    to_X_rel_Y.back()(0, 0, f.width(), g_to_X.width()) = g_to_X;
-
-    MatrixQ fg = f * g_to_X;
-    for (dim_t i = 0; i < Y.tor_rank(); ++i) {
-      for (dim_t j = 0; j < g_to_X.width(); ++j) {
-        to_X_rel_Y.back()(f.width() + i, j) = -fg(i, j) / p_pow_z(p, Y(i));
-      }
-    }
+  for (const Matrix<T>& f : G.maps_to) {
+    result.maps_to.push_back(to_rational(f));
   }
 
-  MatrixQList from_X_rel_Y;
-  for (MatrixQ& g_from_X : from_X_ref) {
-    from_X_rel_Y.emplace_back(g_from_X.height(), f.width() + Y.tor_rank());
-    from_X_rel_Y.back()(0, 0, g_from_X.height(), f.width()) = g_from_X;
+  for (const Matrix<T>& f : G.maps_from) {
+    result.maps_from.push_back(to_rational(f));
   }
 
-  MatrixQRefList to_X_rel_Y_ref = ref(to_X_rel_Y);
-  MatrixQRefList from_X_rel_Y_ref = ref(from_X_rel_Y);
+  return result;
+}
 
-  to_X_rel_Y_ref.emplace_back(rel_x_lift);
+template <typename T>
+static KernelAndCokernel to_rational(const BasicKernelAndCokernel<T>& KC)
+{
+  return {to_rational(KC.kernel), to_rational(KC.cokernel)};
+}
 
-  MatrixQRefList to_Y;
-  MatrixQRefList from_Y;
-  smith_reduce_p(p, f_rel_Y, to_X_rel_Y_ref, from_X_rel_Y_ref, to_Y, from_Y);
+// The following run the generic algorithms over T on rational input, with the
+// instantiation for p = 2 if it applies.
+template <typename T>
+static GroupWithMorphisms compute_cokernel_over(
+    const mod_t p, const MatrixQ& f, const AbelianGroup& Y,
+    const MatrixQRefList& to_Y_ref, const MatrixQRefList& from_Y_ref)
+{
+  MatrixList<T> to_Y = matrix_cast<T>(to_Y_ref);
+  MatrixList<T> from_Y = matrix_cast<T>(from_Y_ref);
+
+  if (p == 2)
+    return to_rational(compute_cokernel<T, 2>(p, matrix_cast<T>(f), Y,
+                                              ref(to_Y), ref(from_Y)));
+  return to_rational(
+      compute_cokernel(p, matrix_cast<T>(f), Y, ref(to_Y), ref(from_Y)));
+}
 
-  dim_t rank_diff;
-  for (rank_diff = 0; rank_diff < std::min(f_rel_Y.height(), f_rel_Y.width());
-       ++rank_diff) {
-    if (f_rel_Y(rank_diff, rank_diff) == 0) break;
-  }
+template <typename T>
+static GroupWithMorphisms compute_kernel_over(
+    const mod_t p, const MatrixQ& f, const AbelianGroup& X,
+    const AbelianGroup& Y, const MatrixQRefList& to_X_ref,
+    const MatrixQRefList& from_X_ref)
+{
+  MatrixList<T> to_X = matrix_cast<T>(to_X_ref);
+  MatrixList<T> from_X = matrix_cast<T>(from_X_ref);
+
+  if (p == 2)
+    return to_rational(compute_kernel<T, 2>(p, matrix_cast<T>(f), X, Y,
+                                            ref(to_X), ref(from_X)));
+  return to_rational(
+      compute_kernel(p, matrix_cast<T>(f), X, Y, ref(to_X), ref(from_X)));
+}
 
-  // next, restrict attention to the entries corresponding to zero columns of
-  // f_rel_Y:
-  // for rel_x_lift as well as the entries of to_X_rel_Y, take the submatrices
-  // formed
-  // by the corresponding rows. For from_X_rel_Y, take the submatrices formed
-  // by
-  // the corresponding columns.
-  MatrixQ rel_K = rel_x_lift(rank_diff, 0, rel_x_lift.height() - rank_diff,
-                             rel_x_lift.width());
-  MatrixQList to_free_K;
-  for (MatrixQ& g_to_X_rel_Y : to_X_rel_Y) {
-    to_free_K.emplace_back(g_to_X_rel_Y(
-        rank_diff, 0, g_to_X_rel_Y.height() - rank_diff, g_to_X_rel_Y.width()));
-  }
-  MatrixQList from_free_K;
+template <typename T>
+static KernelAndCokernel compute_kernel_and_cokernel_over(
+    const mod_t p, const MatrixQ& f, const AbelianGroup& X,
+    const AbelianGroup& Y, const MatrixQRefList& to_X_ref,
+    const MatrixQRefList& from_X_ref, const MatrixQRefList& to_Y_ref,
+    const MatrixQRefList& from_Y_ref)
+{
+  MatrixList<T> to_X = matrix_cast<T>(to_X_ref);
+  MatrixList<T> from_X = matrix_cast<T>(from_X_ref);
+  MatrixList<T> to_Y = matrix_cast<T>(to_Y_ref);
+  MatrixList<T> from_Y = matrix_cast<T>(from_Y_ref);
+
+  if (p == 2)
+    return to_rational(compute_kernel_and_cokernel<T, 2>(
+        p, matrix_cast<T>(f), X, Y, ref(to_X), ref(from_X), ref(to_Y),
+        ref(from_Y)));
+  return to_rational(compute_kernel_and_cokernel(
+      p, matrix_cast<T>(f), X, Y, ref(to_X), ref(from_X), ref(to_Y),
+      ref(from_Y)));
+}
 
-  for (MatrixQ& g_from_X_rel_Y : from_X_rel_Y) {
-    from_free_K.emplace_back(
-        g_from_X_rel_Y(0, rank_diff, g_from_X_rel_Y.height(),
-                       g_from_X_rel_Y.width() - rank_diff));
-  }
+template <typename T>
+static GroupWithMorphisms compute_image_over(const mod_t p, const MatrixQ& f,
+                                             const AbelianGroup& X,
+                                             const AbelianGroup& Y)
+{
+  if (p == 2)
+    return to_rational(compute_image<T, 2>(p, matrix_cast<T>(f), X, Y));
+  return to_rational(compute_image(p, matrix_cast<T>(f), X, Y));
+}
 
-  MatrixQRefList to_free_K_ref = ref(to_free_K);
-  MatrixQRefList from_free_K_ref = ref(from_free_K);
+template <typename T>
+static MatrixQ lift_from_free_over(const mod_t p, const MatrixQ& f,
+                                   const MatrixQ& map, const AbelianGroup& Y)
+{
+  if (p == 2)
+    return to_rational(
+        lift_from_free<T, 2>(p, matrix_cast<T>(f), matrix_cast<T>(map), Y));
+  return to_rational(
+      lift_from_free(p, matrix_cast<T>(f), matrix_cast<T>(map), Y));
+}
+
+template <typename T>
+static AbelianGroup compute_cokernel_group_over(const mod_t p,
+                                                const MatrixQ& f,
+                                                const AbelianGroup& Y)
+{
+  if (p == 2) return compute_cokernel_group<T, 2>(p, matrix_cast<T>(f), Y);
+  return compute_cokernel_group(p, matrix_cast<T>(f), Y);
+}
 
-  AbelianGroup free_K(rel_K.height(), 0);
-  // then, compute the cokernel of the new rel_x_lift with the respective
-  // to_Y, from_Y.
-  return compute_cokernel(p, rel_K, free_K, to_free_K_ref, from_free_K_ref);
+template <typename T>
+static AbelianGroup compute_image_group_over(const mod_t p, const MatrixQ& f,
+                                             const AbelianGroup& Y)
+{
+  if (p == 2) return compute_image_group<T, 2>(p, matrix_cast<T>(f), Y);
+  return compute_image_group(p, matrix_cast<T>(f), Y);
+}
+
+GroupWithMorphisms compute_cokernel(const mod_t p, const MatrixQ& f,
+                                    const AbelianGroup& Y,
+                                    const MatrixQRefList& to_Y_ref,
+                                    const MatrixQRefList& from_Y_ref)
+{
+  if (coefficients_ == Coefficients::small_rational)
+    return compute_cokernel_over<HybridQ>(p, f, Y, to_Y_ref, from_Y_ref);
+
+  u_val_t precision =
+      mod_p_power_precision(p, Y, Y, f, {&to_Y_ref, &from_Y_ref});
+  if (precision == 0 && p == 2)
+    return compute_cokernel<mpq_class, 2>(p, f, Y, to_Y_ref, from_Y_ref);
+  if (precision == 0)
+    return compute_cokernel<mpq_class>(p, f, Y, to_Y_ref, from_Y_ref);
+
+  ModPN::Context context(p, precision);
+  return compute_cokernel_over<ModPN>(p, f, Y, to_Y_ref, from_Y_ref);
+}
+
+GroupWithMorphisms compute_kernel(const mod_t p, const MatrixQ& f,
+                                  const AbelianGroup& X, const AbelianGroup& Y,
+                                  const MatrixQRefList& to_X_ref,
+                                  const MatrixQRefList& from_X_ref)
+{
+  if (coefficients_ == Coefficients::small_rational)
+    return compute_kernel_over<HybridQ>(p, f, X, Y, to_X_ref, from_X_ref);
+
+  u_val_t precision =
+      mod_p_power_precision(p, X, Y, f, {&to_X_ref, &from_X_ref});
+  if (precision == 0 && p == 2)
+    return compute_kernel<mpq_class, 2>(p, f, X, Y, to_X_ref, from_X_ref);
+  if (precision == 0)
+    return compute_kernel<mpq_class>(p, f, X, Y, to_X_ref, from_X_ref);
+
+  ModPN::Context context(p, precision);
+  return compute_kernel_over<ModPN>(p, f, X, Y, to_X_ref, from_X_ref);
+}
+
+KernelAndCokernel compute_kernel_and_cokernel(
+    const mod_t p, const MatrixQ& f, const AbelianGroup& X,
+    const AbelianGroup& Y, const MatrixQRefList& to_X_ref,
+    const MatrixQRefList& from_X_ref, const MatrixQRefList& to_Y_ref,
+    const MatrixQRefList& from_Y_ref)
+{
+  if (coefficients_ == Coefficients::small_rational)
+    return compute_kernel_and_cokernel_over<HybridQ>(
+        p, f, X, Y, to_X_ref, from_X_ref, to_Y_ref, from_Y_ref);
+
+  u_val_t precision = mod_p_power_precision(
+      p, X, Y, f, {&to_X_ref, &from_X_ref, &to_Y_ref, &from_Y_ref});
+  if (precision == 0 && p == 2)
+    return compute_kernel_and_cokernel<mpq_class, 2>(
+        p, f, X, Y, to_X_ref, from_X_ref, to_Y_ref, from_Y_ref);
+  if (precision == 0)
+    return compute_kernel_and_cokernel<mpq_class>(
+        p, f, X, Y, to_X_ref, from_X_ref, to_Y_ref, from_Y_ref);
+
+  ModPN::Context context(p, precision);
+  return compute_kernel_and_cokernel_over<ModPN>(
+      p, f, X, Y, to_X_ref, from_X_ref, to_Y_ref, from_Y_ref);
 }
 
 GroupWithMorphisms compute_image(const mod_t p, const MatrixQ& f,
                                  const AbelianGroup& X, const AbelianGroup& Y)
 {
-  MatrixQRefList to_X_dummy;
-  MatrixQList from_X = {MatrixQ::identity(f.width())};
-  GroupWithMorphisms K = compute_kernel(p, f, X, Y, to_X_dummy, ref(from_X));
-
-  MatrixQList to_X_2 =  {MatrixQ::identity(X.rank())};
-  MatrixQList from_X_2 = {f,MatrixQ::identity(X.rank())};//hacky, since id:X->X doesn't vanish on K.
-                                                         //but due to the implementation, the columns of this will contain
-                                                         //representatives in X for the generators of img.
-  GroupWithMorphisms img =
-      compute_cokernel(p, K.maps_from[0], X, ref(to_X_2), ref(from_X_2));
-
-  return img;
-}
-
-// lifts a map from f:F -> Y over the map map: X -> Y. We only need relations
-// for Y.
-// Remark 1: does NOT catch if such a lift doesn't exist!
-// Remark 2: If the map X -> Y is injective, then for a map A -> Y the lift F_A
-// -> X of the map
-//           F_A -> Y induces a well-defined map A -> X.
-//           In general, the problem whether there IS such a lift, and how to
-//           compute it,
-//           will involve additional work.
+  if (coefficients_ == Coefficients::small_rational)
+    return compute_image_over<HybridQ>(p, f, X, Y);
+
+  u_val_t precision = mod_p_power_precision(p, X, Y, f);
+  if (precision == 0 && p == 2) return compute_image<mpq_class, 2>(p, f, X, Y);
+  if (precision == 0) return compute_image<mpq_class>(p, f, X, Y);
+
+  ModPN::Context context(p, precision);
+  return compute_image_over<ModPN>(p, f, X, Y);
+}
+
 MatrixQ lift_from_free(const mod_t p, const MatrixQ& f, const MatrixQ& map,
                        const AbelianGroup& Y)
 {
+  if (coefficients_ == Coefficients::small_rational)
+    return lift_from_free_over<HybridQ>(p, f, map, Y);
 
+  u_val_t precision = mod_p_power_precision(p, Y, Y, f);
+  if (!below_precision(p, map, precision)) precision = 0;
+  if (precision == 0 && p == 2)
+    return lift_from_free<mpq_class, 2>(p, f, map, Y);
+  if (precision == 0) return lift_from_free<mpq_class>(p, f, map, Y);
 
-  MatrixQ rel_y_map(map.height(), Y.tor_rank() + map.width());
-
-  rel_y_map(Y.free_rank(), 0, Y.tor_rank(), Y.tor_rank()) = Y.torsion_matrix(p);
+  ModPN::Context context(p, precision);
+  return lift_from_free_over<ModPN>(p, f, map, Y);
+}
 
-  rel_y_map(0, Y.tor_rank(), map.height(), map.width()) = map;
+AbelianGroup compute_cokernel_group(const mod_t p, const MatrixQ& f,
+                                    const AbelianGroup& Y)
+{
+  if (coefficients_ == Coefficients::small_rational)
+    return compute_cokernel_group_over<HybridQ>(p, f, Y);
 
-  MatrixQ proj(map.width(), Y.tor_rank() + map.width());
-  proj(0, Y.tor_rank(), map.width(), map.width()) =
-      MatrixQ::identity(map.width());
+  u_val_t precision = mod_p_power_precision(p, Y, Y, f);
+  if (precision == 0 && p == 2)
+    return compute_cokernel_group<mpq_class, 2>(p, f, Y);
+  if (precision == 0) return compute_cokernel_group<mpq_class>(p, f, Y);
 
-  MatrixQ f_copy(f);
+  ModPN::Context context(p, precision);
+  return compute_cokernel_group_over<ModPN>(p, f, Y);
+}
 
-  MatrixQRefList to_X_dummy;
-  MatrixQRefList from_Y_dummy;
-  MatrixQRefList from_X_ref;
-  MatrixQRefList to_Y_ref;
+AbelianGroup compute_image_group(const mod_t p, const MatrixQ& f,
+                                 const AbelianGroup& Y)
+{
+  if (coefficients_ == Coefficients::small_rational)
+    return compute_image_group_over<HybridQ>(p, f, Y);
 
-  from_X_ref.emplace_back(proj);
-  to_Y_ref.emplace_back(f_copy);
+  u_val_t precision = mod_p_power_precision(p, Y, Y, f);
+  if (precision == 0 && p == 2)
+    return compute_image_group<mpq_class, 2>(p, f, Y);
+  if (precision == 0) return compute_image_group<mpq_class>(p, f, Y);
 
-  smith_reduce_p(p, rel_y_map, to_X_dummy, from_X_ref, to_Y_ref, from_Y_dummy);
+  ModPN::Context context(p, precision);
+  return compute_image_group_over<ModPN>(p, f, Y);
+}
 
-  MatrixQ lift(rel_y_map.width(), f.width());
+static const MatrixQ& to_rational(const MatrixQ& f)
+{
+  return f;
+}
 
-  dim_t d_max = 0;
-  while (d_max < rel_y_map.height() && d_max < rel_y_map.width() &&
-         rel_y_map(d_max, d_max) != 0) {
-    d_max++;
+class PreparedLift::Solver
+{
+ public:
+  virtual ~Solver() = default;
+  virtual MatrixQList lift(const MatrixQList& fs) const = 0;
+};
+
+// a BasicPreparedLift over T. Its entries are only meaningful in Z/p^N while
+// that precision is installed, so for ModPN every lift installs it again.
+template <typename T, mod_t P>
+class PreparedLiftOver : public PreparedLift::Solver
+{
+ public:
+  PreparedLiftOver(const mod_t p, const MatrixQ& map, const AbelianGroup& Y,
+                   const u_val_t precision)
+      : p_(p), precision_(precision), prepared_(p, matrix_cast<T>(map), Y)
+  {
   }
 
-  for (dim_t i = 0; i < d_max; i++) {
-    for (dim_t j = 0; j < f.width(); j++) {
-      lift(i, j) = f_copy(i, j) / rel_y_map(i, i);
+  MatrixQList lift(const MatrixQList& fs) const override
+  {
+    std::unique_ptr<ModPN::Context> context;
+    if (precision_ != 0) context.reset(new ModPN::Context(p_, precision_));
+
+    MatrixList<T> fs_over;
+    fs_over.reserve(fs.size());
+    for (const MatrixQ& f : fs) {
+      fs_over.push_back(matrix_cast<T>(f));
     }
+
+    MatrixQList lifts;
+    for (const Matrix<T>& lift : prepared_.lift(std::move(fs_over))) {
+      lifts.push_back(to_rational(lift));
+    }
+    return lifts;
   }
 
-  return proj * lift;
+ private:
+  const mod_t p_;
+  const u_val_t precision_;
+  BasicPreparedLift<T, P> prepared_;
+};
+
+template <typename T>
+static PreparedLift::Solver* prepared_lift_over(const mod_t p,
+                                                const MatrixQ& map,
+                                                const AbelianGroup& Y,
+                                                const u_val_t precision = 0)
+{
+  if (p == 2) return new PreparedLiftOver<T, 2>(p, map, Y, precision);
+  return new PreparedLiftOver<T, 0>(p, map, Y, precision);
 }
 
-bool morphism_equal(mod_t p, const MatrixQ& f, const MatrixQ& g,
-                    const AbelianGroup& Y)
+PreparedLift::PreparedLift(const mod_t p, const MatrixQ& map,
+                           const AbelianGroup& Y)
+{
+  if (coefficients_ == Coefficients::small_rational) {
+    solver_.reset(prepared_lift_over<HybridQ>(p, map, Y));
+    return;
+  }
+
+  // Y is torsion of orders below the precision if one is used, so the maps
+  // lifted later are faithful in Z/p^N whatever their entries.
+  u_val_t precision = mod_p_power_precision(p, Y, Y, map);
+  if (precision == 0) {
+    solver_.reset(prepared_lift_over<mpq_class>(p, map, Y));
+    return;
+  }
+
+  ModPN::Context context(p, precision);
+  solver_.reset(prepared_lift_over<ModPN>(p, map, Y, precision));
+}
+
+PreparedLift::~PreparedLift() = default;
+
+MatrixQ PreparedLift::lift(const MatrixQ& f) const
 {
+  return std::move(solver_->lift(MatrixQList{f}).front());
+}
+
+MatrixQList PreparedLift::lift(const MatrixQList& fs) const
+{
+  return solver_->lift(fs);
+}
+
+template <mod_t P>
+static bool morphism_equal_over(const Prime<P> p, const MatrixQ& f,
+                                const MatrixQ& g, const AbelianGroup& Y)
+{
+  static thread_local mpq_class difference;
+
   for (dim_t i = 0; i < f.height(); i++) {
+    MatrixVector<const mpq_class> f_row = f.row(i);
+    MatrixVector<const mpq_class> g_row = g.row(i);
+
     for (dim_t j = 0; j < f.width(); j++) {
-      if (f(i, j) != g(i, j)) {
-        if (i >= Y.tor_rank() ||
-            static_cast<dim_t>(p_val_q(p, f(i, j) - g(i, j))) < Y(i)) {
-          return false;
-        }
+      if (f_row[j] != g_row[j]) {
+        if (i >= Y.tor_rank()) return false;
+
+        mpq_sub(difference.get_mpq_t(), f_row[j].get_mpq_t(),
+                g_row[j].get_mpq_t());
+        if (static_cast<dim_t>(p_val_q(p, difference)) < Y(i)) return false;
       }
     }
   }
   return true;
 }
 
+bool morphism_equal(mod_t p, const MatrixQ& f, const MatrixQ& g,
+                    const AbelianGroup& Y)
+{
+  if (p == 2) return morphism_equal_over(Prime<2>(p), f, g, Y);
+  return morphism_equal_over(Prime<0>(p), f, g, Y);
+}
+
 bool morphism_zero(mod_t p, const MatrixQ& f, const AbelianGroup& Y)
 {
   MatrixQ g(f.height(), f.width());
@@ -1,19 +1,144 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include "abelian_group.h"
 #include "matrix.h"
+#include "smith.h"
 #include "types.h"
 
-struct GroupWithMorphisms {
+template <typename T>
+struct BasicGroupWithMorphisms {
  public:
-  GroupWithMorphisms() = default;
-  GroupWithMorphisms(const dim_t free_rank, const dim_t tor_rank);
+  BasicGroupWithMorphisms() = default;
+  BasicGroupWithMorphisms(const dim_t free_rank, const dim_t tor_rank);
 
   AbelianGroup group;
-  MatrixQList maps_to;
-  MatrixQList maps_from;
+  MatrixList<T> maps_to;
+  MatrixList<T> maps_from;
+};
+
+using GroupWithMorphisms = BasicGroupWithMorphisms<mpq_class>;
+
+template <typename T>
+struct BasicKernelAndCokernel {
+  BasicGroupWithMorphisms<T> kernel;
+  BasicGroupWithMorphisms<T> cokernel;
+};
+
+using KernelAndCokernel = BasicKernelAndCokernel<mpq_class>;
+
+// The coefficients the MatrixQ versions below compute with.
+// rational: exact computation in Q.
+// small_rational: exact computation in Q via HybridQ, which avoids GMP as long
+//   as numerators and denominators fit into 64 bits.
+// mod_p_power: computation in Z/p^N via ModPN, where N is the largest order
+//   of the groups involved plus a safety margin. Falls back to rational
+//   coefficients if a group has a free summand, if a map has an entry of
+//   valuation N or more, or if p^N does not fit into a machine word.
+enum class Coefficients { rational, small_rational, mod_p_power };
+
+void set_coefficients(const Coefficients coefficients,
+                      const u_val_t precision_margin = 8);
+Coefficients get_coefficients();
+
+// installs coefficients for as long as it lives and restores the previous
+// ones when destroyed, so that an owner such as a Session does not switch
+// the coefficients of everyone else.
+class CoefficientsScope
+{
+ public:
+  CoefficientsScope(const Coefficients coefficients,
+                    const u_val_t precision_margin = 8);
+  ~CoefficientsScope();
+
+  CoefficientsScope(const CoefficientsScope&) = delete;
+  CoefficientsScope& operator=(const CoefficientsScope&) = delete;
+
+ private:
+  Coefficients prev_coefficients_;
+  u_val_t prev_precision_margin_;
+};
+
+// The generic algorithms. P fixes the prime at compile time, see Prime; the
+// MatrixQ versions below select the instantiation for P = 2 when p = 2.
+
+template <typename T, mod_t P = 0>
+BasicGroupWithMorphisms<T> compute_cokernel(const mod_t p, const Matrix<T>& f,
+                                            const AbelianGroup& Y,
+                                            const MatrixRefList<T>& to_Y_ref,
+                                            const MatrixRefList<T>& from_Y_ref);
+
+template <typename T, mod_t P = 0>
+BasicGroupWithMorphisms<T> compute_kernel(const mod_t p, const Matrix<T>& f,
+                                          const AbelianGroup& X,
+                                          const AbelianGroup& Y,
+                                          const MatrixRefList<T>& to_X_ref,
+                                          const MatrixRefList<T>& from_X_ref);
+
+// compute_kernel and compute_cokernel of the same f, which share the
+// reduction of (f | rel_Y).
+template <typename T, mod_t P = 0>
+BasicKernelAndCokernel<T> compute_kernel_and_cokernel(
+    const mod_t p, const Matrix<T>& f, const AbelianGroup& X,
+    const AbelianGroup& Y, const MatrixRefList<T>& to_X_ref,
+    const MatrixRefList<T>& from_X_ref, const MatrixRefList<T>& to_Y_ref,
+    const MatrixRefList<T>& from_Y_ref);
+
+// the image of f with maps_to the projection from X onto it, and maps_from
+// its inclusion into Y followed by representatives in X of its generators.
+// Reduces (f | rel_Y) and then the preimage of rel_Y.
+template <typename T, mod_t P = 0>
+BasicGroupWithMorphisms<T> compute_image(const mod_t p, const Matrix<T>& f,
+                                         const AbelianGroup& X,
+                                         const AbelianGroup& Y);
+
+// compute_image as the cokernel of the inclusion of the kernel of f, with
+// three reductions. The reference for compute_image.
+template <typename T, mod_t P = 0>
+BasicGroupWithMorphisms<T> compute_image_by_kernel(const mod_t p,
+                                                   const Matrix<T>& f,
+                                                   const AbelianGroup& X,
+                                                   const AbelianGroup& Y);
+
+template <typename T, mod_t P = 0>
+Matrix<T> lift_from_free(const mod_t p, const Matrix<T>& f,
+                         const Matrix<T>& map, const AbelianGroup& Y);
+
+// lift_from_free over the same map and Y for many f. (rel_Y | map) is
+// reduced once; a lift replays the row operations of the reduction on f and
+// divides by the diagonal. Lifting a list replays them once for all of it.
+template <typename T, mod_t P = 0>
+class BasicPreparedLift
+{
+ public:
+  BasicPreparedLift(const mod_t p, const Matrix<T>& map,
+                    const AbelianGroup& Y);
+
+  Matrix<T> lift(const Matrix<T>& f) const;
+  MatrixList<T> lift(MatrixList<T> fs) const;
+
+ private:
+  BasisChange<T> Y_change_;
+  // the nonzero diagonal entries of the reduced (rel_Y | map).
+  std::vector<T> diagonal_;
+  // the projection from the basis of the reduction to the generators of
+  // the source of map.
+  Matrix<T> proj_;
 };
 
+// Only the groups of compute_cokernel and compute_image, computed without the
+// maps to and from them. The image of f: X -> Y only depends on Y.
+
+template <typename T, mod_t P = 0>
+AbelianGroup compute_cokernel_group(const mod_t p, const Matrix<T>& f,
+                                    const AbelianGroup& Y);
+
+template <typename T, mod_t P = 0>
+AbelianGroup compute_image_group(const mod_t p, const Matrix<T>& f,
+                                 const AbelianGroup& Y);
+
 GroupWithMorphisms compute_cokernel(const mod_t p, const MatrixQ& f,
                                     const AbelianGroup& Y,
                                     const MatrixQRefList& to_Y_ref,
@@ -24,12 +149,43 @@ GroupWithMorphisms compute_kernel(const mod_t p, const MatrixQ& f,
                                   const MatrixQRefList& to_X_ref,
                                   const MatrixQRefList& from_X_ref);
 
+KernelAndCokernel compute_kernel_and_cokernel(
+    const mod_t p, const MatrixQ& f, const AbelianGroup& X,
+    const AbelianGroup& Y, const MatrixQRefList& to_X_ref,
+    const MatrixQRefList& from_X_ref, const MatrixQRefList& to_Y_ref,
+    const MatrixQRefList& from_Y_ref);
+
 GroupWithMorphisms compute_image(const mod_t p, const MatrixQ& f,
                                  const AbelianGroup& X, const AbelianGroup& Y);
 
 MatrixQ lift_from_free(const mod_t p, const MatrixQ& f, const MatrixQ& map,
                        const AbelianGroup& Y);
 
+// BasicPreparedLift over the coefficients of get_coefficients() at
+// construction.
+class PreparedLift
+{
+ public:
+  PreparedLift(const mod_t p, const MatrixQ& map, const AbelianGroup& Y);
+  ~PreparedLift();
+
+  MatrixQ lift(const MatrixQ& f) const;
+  MatrixQList lift(const MatrixQList& fs) const;
+
+  class Solver;
+
+ private:
+  std::unique_ptr<Solver> solver_;
+};
+
+AbelianGroup compute_cokernel_group(const mod_t p, const MatrixQ& f,
+                                    const AbelianGroup& Y);
+
+AbelianGroup compute_image_group(const mod_t p, const MatrixQ& f,
+                                 const AbelianGroup& Y);
+
 bool morphism_equal(mod_t p, const MatrixQ& f, const MatrixQ& g,
                     const AbelianGroup& Y);
 bool morphism_zero(mod_t p, const MatrixQ& f, const AbelianGroup& Y);
+
+#include "morphisms_impl.h"
@@ -0,0 +1,455 @@
+#include <utility>
+#include <vector>
+
+#include "p_local.h"
+#include "smith.h"
+
+template <typename T>
+BasicGroupWithMorphisms<T>::BasicGroupWithMorphisms(const dim_t free_rank,
+                                                    const dim_t tor_rank)
+    : group(free_rank, tor_rank)
+{
+}
+
+// (f | rel_Y), the map from the generators of X and the relations of Y to Y.
+template <typename T>
+Matrix<T> append_relations(const mod_t p, const Matrix<T>& f,
+                           const AbelianGroup& Y)
+{
+  Matrix<T> f_rel_Y(f.height(), f.width() + Y.tor_rank());
+  f_rel_Y(0, 0, f.height(), f.width()) = f;
+  f_rel_Y(0, f.width(), Y.tor_rank(), Y.tor_rank()) =
+      Y.torsion_matrix<T>(p);
+  return f_rel_Y;
+}
+
+// the cokernel of f, from the Smith normal form of (f | rel_Y) and the maps
+// to and from Y in its basis.
+template <typename T>
+BasicGroupWithMorphisms<T> cokernel_from_reduced(const mod_t p,
+                                                 const Matrix<T>& f_rel_Y,
+                                                 MatrixList<T>& to_Y,
+                                                 MatrixList<T>& from_Y)
+{
+  dim_t rank_diff = 0;
+  dim_t torsion_rank = 0;
+
+  for (dim_t i = 0; i < std::min(f_rel_Y.height(), f_rel_Y.width()); ++i) {
+    if (f_rel_Y(i, i) == 1)
+      ++rank_diff;
+    else if (f_rel_Y(i, i) != 0)
+      ++torsion_rank;
+    else
+      break;
+  }
+
+  BasicGroupWithMorphisms<T> C(f_rel_Y.height() - rank_diff - torsion_rank,
+                               torsion_rank);
+  for (dim_t i = rank_diff; i < rank_diff + torsion_rank; ++i)
+    C.group(i - rank_diff) = static_cast<dim_t>(p_val_q(p, f_rel_Y(i, i)));
+
+  for (Matrix<T>& g_to_Y : to_Y)
+    C.maps_to.emplace_back(
+        g_to_Y(rank_diff, 0, g_to_Y.height() - rank_diff, g_to_Y.width()));
+
+  for (Matrix<T>& g_from_Y : from_Y)
+    C.maps_from.emplace_back(g_from_Y(0, rank_diff, g_from_Y.height(),
+                                      g_from_Y.width() - rank_diff));
+
+  return C;
+}
+
+// the maps that compute_kernel changes along with the columns of
+// (f | rel_Y): the maps to and from X extended to the generators of X and
+// the relations of Y, and rel_x_lift, the relations of X together with
+// minus a lift of f applied to them over rel_Y.
+template <typename T>
+struct KernelMaps
+{
+  Matrix<T> rel_x_lift;
+  MatrixList<T> to_X_rel_Y;
+  MatrixList<T> from_X_rel_Y;
+
+  MatrixRefList<T> to_ref()
+  {
+    MatrixRefList<T> result = ref(to_X_rel_Y);
+    result.emplace_back(rel_x_lift);
+    return result;
+  }
+
+  MatrixRefList<T> from_ref()
+  {
+    return ref(from_X_rel_Y);
+  }
+};
+
+template <typename T, mod_t P>
+KernelMaps<T> kernel_maps(const mod_t p, const Matrix<T>& f,
+                          const AbelianGroup& X, const AbelianGroup& Y,
+                          const MatrixRefList<T>& to_X_ref,
+                          const MatrixRefList<T>& from_X_ref)
+{
+  const Prime<P> prime(p);
+  KernelMaps<T> maps;
+
+  Matrix<T>& rel_x_lift = maps.rel_x_lift;
+  rel_x_lift = Matrix<T>(f.width() + Y.tor_rank(), X.tor_rank());
+  rel_x_lift(0, 0, X.tor_rank(), X.tor_rank()) = X.torsion_matrix<T>(p);
+  // rel_x_lift(f.width(), 0, Y.tor_rank(), X.tor_rank()) = -lift of f\circ
+  // rel_x over rel_Y.
+  //      Can be computed by multiplying the columns of f with the orders of X,
+  //      and dividing the rows by the orders of Y.
+
+  for (dim_t i = 0; i < Y.tor_rank(); ++i) {
+    for (dim_t j = 0; j < X.tor_rank(); ++j) {
+      if (X(j) >= Y(i))
+        rel_x_lift(f.width() + i, j) =
+            -mul_p_pow(prime, f(i, j), X(j) - Y(i));
+      else
+        rel_x_lift(f.width() + i, j) =
+            -div_p_pow(prime, f(i, j), Y(i) - X(j));
+    }
+  }
+
+  // build to_X_rel_Y, from_X_rel_Y.
+  MatrixList<T>& to_X_rel_Y = maps.to_X_rel_Y;
+  for (Matrix<T>& g_to_X : to_X_ref) {
+    to_X_rel_Y.emplace_back(f.width() + Y.tor_rank(), g_to_X.width());
+    to_X_rel_Y.back()(0, 0, f.width(), g_to_X.width()) = g_to_X;
+
+    Matrix<T> fg = f * g_to_X;
+    for (dim_t i = 0; i < Y.tor_rank(); ++i) {
+      for (dim_t j = 0; j < g_to_X.width(); ++j) {
+        to_X_rel_Y.back()(f.width() + i, j) =
+            -div_p_pow(prime, fg(i, j), Y(i));
+      }
+    }
+  }
+
+  MatrixList<T>& from_X_rel_Y = maps.from_X_rel_Y;
+  for (Matrix<T>& g_from_X : from_X_ref) {
+    from_X_rel_Y.emplace_back(g_from_X.height(), f.width() + Y.tor_rank(),
+                              Layout::column_major);
+    from_X_rel_Y.back()(0, 0, g_from_X.height(), f.width()) = g_from_X;
+  }
+
+  return maps;
+}
+
+// the kernel of f, from the Smith normal form of (f | rel_Y) and the
+// kernel_maps in its basis.
+template <typename T, mod_t P>
+BasicGroupWithMorphisms<T> kernel_from_reduced(const mod_t p,
+                                               const Matrix<T>& f_rel_Y,
+                                               KernelMaps<T>& maps)
+{
+  dim_t rank_diff;
+  for (rank_diff = 0; rank_diff < std::min(f_rel_Y.height(), f_rel_Y.width());
+       ++rank_diff) {
+    if (f_rel_Y(rank_diff, rank_diff) == 0) break;
+  }
+
+  // next, restrict attention to the entries corresponding to zero columns of
+  // f_rel_Y:
+  // for rel_x_lift as well as the entries of to_X_rel_Y, take the submatrices
+  // formed
+  // by the corresponding rows. For from_X_rel_Y, take the submatrices formed
+  // by
+  // the corresponding columns.
+  Matrix<T>& rel_x_lift = maps.rel_x_lift;
+  Matrix<T> rel_K = rel_x_lift(rank_diff, 0, rel_x_lift.height() - rank_diff,
+                               rel_x_lift.width());
+  MatrixList<T> to_free_K;
+  for (Matrix<T>& g_to_X_rel_Y : maps.to_X_rel_Y) {
+    to_free_K.emplace_back(g_to_X_rel_Y(
+        rank_diff, 0, g_to_X_rel_Y.height() - rank_diff, g_to_X_rel_Y.width()));
+  }
+  MatrixList<T> from_free_K;
+
+  for (Matrix<T>& g_from_X_rel_Y : maps.from_X_rel_Y) {
+    from_free_K.emplace_back(
+        g_from_X_rel_Y(0, rank_diff, g_from_X_rel_Y.height(),
+                       g_from_X_rel_Y.width() - rank_diff));
+  }
+
+  MatrixRefList<T> to_free_K_ref = ref(to_free_K);
+  MatrixRefList<T> from_free_K_ref = ref(from_free_K);
+
+  AbelianGroup free_K(rel_K.height(), 0);
+  // then, compute the cokernel of the new rel_x_lift with the respective
+  // to_Y, from_Y.
+  return compute_cokernel<T, P>(p, rel_K, free_K, to_free_K_ref,
+                                from_free_K_ref);
+}
+
+template <typename T, mod_t P>
+BasicGroupWithMorphisms<T> compute_cokernel(const mod_t p, const Matrix<T>& f,
+                                            const AbelianGroup& Y,
+                                            const MatrixRefList<T>& to_Y_ref,
+                                            const MatrixRefList<T>& from_Y_ref)
+{
+  Matrix<T> f_rel_Y = append_relations(p, f, Y);
+
+  MatrixList<T> to_Y_copy = deref(to_Y_ref);
+  MatrixList<T> from_Y_copy = deref(from_Y_ref);
+  // the reduction only applies column operations to the maps from Y.
+  for (Matrix<T>& g_from_Y : from_Y_copy) {
+    g_from_Y.set_layout(Layout::column_major);
+  }
+
+  MatrixRefList<T> to_X;
+  MatrixRefList<T> from_X;
+  MatrixRefList<T> to_Y_copy_ref = ref(to_Y_copy);
+  MatrixRefList<T> from_Y_copy_ref = ref(from_Y_copy);
+
+  smith_reduce_p<T, P>(p, f_rel_Y, to_X, from_X, to_Y_copy_ref,
+                       from_Y_copy_ref);
+
+  return cokernel_from_reduced(p, f_rel_Y, to_Y_copy, from_Y_copy);
+}
+
+template <typename T, mod_t P>
+BasicGroupWithMorphisms<T> compute_kernel(const mod_t p, const Matrix<T>& f,
+                                          const AbelianGroup& X,
+                                          const AbelianGroup& Y,
+                                          const MatrixRefList<T>& to_X_ref,
+                                          const MatrixRefList<T>& from_X_ref)
+{
+  Matrix<T> f_rel_Y = append_relations(p, f, Y);
+  KernelMaps<T> maps = kernel_maps<T, P>(p, f, X, Y, to_X_ref, from_X_ref);
+
+  MatrixRefList<T> to_X_rel_Y_ref = maps.to_ref();
+  MatrixRefList<T> from_X_rel_Y_ref = maps.from_ref();
+  MatrixRefList<T> to_Y;
+  MatrixRefList<T> from_Y;
+  smith_reduce_p<T, P>(p, f_rel_Y, to_X_rel_Y_ref, from_X_rel_Y_ref, to_Y,
+                       from_Y);
+
+  return kernel_from_reduced<T, P>(p, f_rel_Y, maps);
+}
+
+template <typename T, mod_t P>
+BasicKernelAndCokernel<T> compute_kernel_and_cokernel(
+    const mod_t p, const Matrix<T>& f, const AbelianGroup& X,
+    const AbelianGroup& Y, const MatrixRefList<T>& to_X_ref,
+    const MatrixRefList<T>& from_X_ref, const MatrixRefList<T>& to_Y_ref,
+    const MatrixRefList<T>& from_Y_ref)
+{
+  Matrix<T> f_rel_Y = append_relations(p, f, Y);
+  KernelMaps<T> maps = kernel_maps<T, P>(p, f, X, Y, to_X_ref, from_X_ref);
+
+  MatrixList<T> to_Y_copy = deref(to_Y_ref);
+  MatrixList<T> from_Y_copy = deref(from_Y_ref);
+  for (Matrix<T>& g_from_Y : from_Y_copy) {
+    g_from_Y.set_layout(Layout::column_major);
+  }
+
+  // the column operations of the reduction change the kernel maps, its row
+  // operations the cokernel maps.
+  BasisChange<T> X_change;
+  BasisChange<T> Y_change;
+  smith_reduce_p<T, P>(p, f_rel_Y, X_change, Y_change);
+
+  MatrixRefList<T> to_X_rel_Y_ref = maps.to_ref();
+  MatrixRefList<T> from_X_rel_Y_ref = maps.from_ref();
+  MatrixRefList<T> to_Y_copy_ref = ref(to_Y_copy);
+  MatrixRefList<T> from_Y_copy_ref = ref(from_Y_copy);
+  X_change.apply(to_X_rel_Y_ref, from_X_rel_Y_ref);
+  Y_change.apply(to_Y_copy_ref, from_Y_copy_ref);
+
+  BasicKernelAndCokernel<T> result;
+  result.kernel = kernel_from_reduced<T, P>(p, f_rel_Y, maps);
+  result.cokernel = cokernel_from_reduced(p, f_rel_Y, to_Y_copy, from_Y_copy);
+  return result;
+}
+
+template <typename T, mod_t P>
+BasicGroupWithMorphisms<T> compute_image_by_kernel(const mod_t p,
+                                                   const Matrix<T>& f,
+                                                   const AbelianGroup& X,
+                                                   const AbelianGroup& Y)
+{
+  MatrixRefList<T> to_X_dummy;
+  MatrixList<T> from_X = {Matrix<T>::identity(f.width())};
+  BasicGroupWithMorphisms<T> K =
+      compute_kernel<T, P>(p, f, X, Y, to_X_dummy, ref(from_X));
+
+  MatrixList<T> to_X_2 =  {Matrix<T>::identity(X.rank())};
+  MatrixList<T> from_X_2 = {f,Matrix<T>::identity(X.rank())};//hacky, since id:X->X doesn't vanish on K.
+                                                             //but due to the implementation, the columns of this will contain
+                                                             //representatives in X for the generators of img.
+  BasicGroupWithMorphisms<T> img =
+      compute_cokernel<T, P>(p, K.maps_from[0], X, ref(to_X_2),
+                             ref(from_X_2));
+
+  return img;
+}
+
+// the generators of the preimage of the relations of Y under f, the
+// projection of the kernel of (f | rel_Y) to the generators of X.
+template <typename T, mod_t P>
+Matrix<T> relations_preimage(const mod_t p, const Matrix<T>& f,
+                             const AbelianGroup& Y)
+{
+  Matrix<T> f_rel_Y = append_relations(p, f, Y);
+
+  Matrix<T> proj(f.width(), f_rel_Y.width(), Layout::column_major);
+  proj(0, 0, f.width(), f.width()) = Matrix<T>::identity(f.width());
+
+  BasisChange<T> X_change;
+  BasisChange<T> Y_change;
+  smith_reduce_p<T, P>(p, f_rel_Y, X_change, Y_change);
+
+  MatrixRefList<T> to_X_dummy;
+  MatrixRefList<T> from_X = {proj};
+  X_change.apply(to_X_dummy, from_X);
+
+  dim_t rank = 0;
+  while (rank < std::min(f_rel_Y.height(), f_rel_Y.width()) &&
+         f_rel_Y(rank, rank) != 0) {
+    ++rank;
+  }
+
+  return proj(0, rank, proj.height(), proj.width() - rank);
+}
+
+// the image is the cokernel of relations_preimage. Its reduction turns the
+// generators of X into representatives of the generators of the image, and f
+// maps them to the generators of the image in Y.
+template <typename T, mod_t P>
+BasicGroupWithMorphisms<T> compute_image(const mod_t p, const Matrix<T>& f,
+                                         const AbelianGroup&,
+                                         const AbelianGroup& Y)
+{
+  Matrix<T> preimage = relations_preimage<T, P>(p, f, Y);
+
+  BasisChange<T> K_change;
+  BasisChange<T> X_change;
+  smith_reduce_p<T, P>(p, preimage, K_change, X_change);
+
+  MatrixList<T> projection = {Matrix<T>::identity(f.width())};
+  MatrixList<T> representatives = {
+      Matrix<T>(f.width(), f.width(), Layout::column_major)};
+  representatives[0](0, 0, f.width(), f.width()) =
+      Matrix<T>::identity(f.width());
+  MatrixRefList<T> projection_ref = ref(projection);
+  MatrixRefList<T> representatives_ref = ref(representatives);
+  X_change.apply(projection_ref, representatives_ref);
+
+  BasicGroupWithMorphisms<T> img =
+      cokernel_from_reduced(p, preimage, projection, representatives);
+  img.maps_from.insert(img.maps_from.begin(), f * img.maps_from[0]);
+  return img;
+}
+
+// lifts a map from f:F -> Y over the map map: X -> Y. We only need relations
+// for Y.
+// Remark 1: does NOT catch if such a lift doesn't exist!
+// Remark 2: If the map X -> Y is injective, then for a map A -> Y the lift F_A
+// -> X of the map
+//           F_A -> Y induces a well-defined map A -> X.
+//           In general, the problem whether there IS such a lift, and how to
+//           compute it,
+//           will involve additional work.
+template <typename T, mod_t P>
+Matrix<T> lift_from_free(const mod_t p, const Matrix<T>& f,
+                         const Matrix<T>& map, const AbelianGroup& Y)
+{
+  return BasicPreparedLift<T, P>(p, map, Y).lift(f);
+}
+
+template <typename T, mod_t P>
+BasicPreparedLift<T, P>::BasicPreparedLift(const mod_t p, const Matrix<T>& map,
+                                           const AbelianGroup& Y)
+    : proj_(map.width(), Y.tor_rank() + map.width(), Layout::column_major)
+{
+  Matrix<T> rel_y_map(map.height(), Y.tor_rank() + map.width());
+
+  rel_y_map(Y.free_rank(), 0, Y.tor_rank(), Y.tor_rank()) =
+      Y.torsion_matrix<T>(p);
+
+  rel_y_map(0, Y.tor_rank(), map.height(), map.width()) = map;
+
+  proj_(0, Y.tor_rank(), map.width(), map.width()) =
+      Matrix<T>::identity(map.width());
+
+  BasisChange<T> X_change;
+  smith_reduce_p<T, P>(p, rel_y_map, X_change, Y_change_);
+
+  MatrixRefList<T> to_X_dummy;
+  MatrixRefList<T> from_X_ref = {proj_};
+  X_change.apply(to_X_dummy, from_X_ref);
+
+  for (dim_t d = 0; d < std::min(rel_y_map.height(), rel_y_map.width()) &&
+                    rel_y_map(d, d) != 0;
+       ++d) {
+    diagonal_.push_back(rel_y_map(d, d));
+  }
+}
+
+template <typename T, mod_t P>
+Matrix<T> BasicPreparedLift<T, P>::lift(const Matrix<T>& f) const
+{
+  return std::move(lift(MatrixList<T>{f}).front());
+}
+
+template <typename T, mod_t P>
+MatrixList<T> BasicPreparedLift<T, P>::lift(MatrixList<T> fs) const
+{
+  MatrixRefList<T> to_Y_ref = ref(fs);
+  MatrixRefList<T> from_Y_dummy;
+  Y_change_.apply(to_Y_ref, from_Y_dummy);
+
+  MatrixList<T> lifts;
+  lifts.reserve(fs.size());
+  for (const Matrix<T>& f : fs) {
+    Matrix<T> solution(proj_.width(), f.width());
+    for (dim_t i = 0; i < diagonal_.size(); i++) {
+      for (dim_t j = 0; j < f.width(); j++) {
+        solution(i, j) = f(i, j) / diagonal_[i];
+      }
+    }
+    lifts.push_back(proj_ * solution);
+  }
+  return lifts;
+}
+
+// the group with the given number of generators and the relations of the
+// given valuations, as returned by smith_valuations_p.
+inline AbelianGroup group_from_valuations(const dim_t generators,
+                                          const std::vector<val_t>& valuations)
+{
+  dim_t rank_diff = 0;
+  while (rank_diff < valuations.size() && valuations[rank_diff] == 0) {
+    ++rank_diff;
+  }
+
+  AbelianGroup group(generators - valuations.size(),
+                     valuations.size() - rank_diff);
+  for (dim_t i = rank_diff; i < valuations.size(); ++i) {
+    group(i - rank_diff) = static_cast<dim_t>(valuations[i]);
+  }
+  return group;
+}
+
+template <typename T, mod_t P>
+AbelianGroup compute_cokernel_group(const mod_t p, const Matrix<T>& f,
+                                    const AbelianGroup& Y)
+{
+  Matrix<T> f_rel_Y = append_relations(p, f, Y);
+
+  return group_from_valuations(
+      f.height(), smith_valuations_p<T, P>(p, std::move(f_rel_Y)));
+}
+
+// the image is the free group on the generators of X modulo the preimage of
+// the relations of Y.
+template <typename T, mod_t P>
+AbelianGroup compute_image_group(const mod_t p, const Matrix<T>& f,
+                                 const AbelianGroup& Y)
+{
+  Matrix<T> preimage = relations_preimage<T, P>(p, f, Y);
+
+  return group_from_valuations(
+      f.width(), smith_valuations_p<T, P>(p, std::move(preimage)));
+}
@@ -1,20 +1,66 @@
+#include <deque>
 #include <limits>
+#include <map>
+#include <unordered_map>
 
 #include "p_local.h"
 
+// p_val_z, with the prime and the remainder passed in as scratch space, so
+// that batch computations allocate them only once.
+static val_t p_val_z(const mod_t p, const mpz_class& x, mpz_srcptr prime,
+                     mpz_class& remainder)
+{
+  if (x == 0) return std::numeric_limits<val_t>::max();
+
+  if (p == 2) return static_cast<val_t>(mpz_scan1(x.get_mpz_t(), 0));
+
+  if (!mpz_divisible_ui_p(x.get_mpz_t(), p)) return 0;
+
+  return static_cast<val_t>(
+      mpz_remove(remainder.get_mpz_t(), x.get_mpz_t(), prime));
+}
+
+static val_t p_val_q(const mod_t p, const mpq_class& x, mpz_srcptr prime,
+                     mpz_class& remainder)
+{
+  val_t num_valuation = p_val_z(p, x.get_num(), prime, remainder);
+
+  if (num_valuation > 0)
+    return num_valuation;
+  else
+    return -p_val_z(p, x.get_den(), prime, remainder);
+}
+
 val_t p_val_z(const mod_t p, const mpz_class& x)
 {
   if (x == 0) return std::numeric_limits<val_t>::max();
 
-  val_t val = 0;
-  mpz_class remainder = x;
+  if (p == 2) return static_cast<val_t>(mpz_scan1(x.get_mpz_t(), 0));
 
-  while (mpz_divisible_ui_p(remainder.get_mpz_t(), p)) {
-    val++;
-    mpz_divexact_ui(remainder.get_mpz_t(), remainder.get_mpz_t(), p);
-  }
+  if (!mpz_divisible_ui_p(x.get_mpz_t(), p)) return 0;
+
+  // reused across calls, so that a single valuation does not allocate.
+  static thread_local mpz_class remainder;
+  mp_limb_t limb = p;
+  mpz_t prime;
+  return p_val_z(p, x, mpz_roinit_n(prime, &limb, 1), remainder);
+}
+
+val_t p_val_z(const Prime<2>, const mpz_class& x)
+{
+  if (x == 0) return std::numeric_limits<val_t>::max();
+
+  return static_cast<val_t>(mpz_scan1(x.get_mpz_t(), 0));
+}
+
+val_t p_val_q(const Prime<2> p, const mpq_class& x)
+{
+  val_t num_valuation = p_val_z(p, x.get_num());
 
-  return val;
+  if (num_valuation > 0)
+    return num_valuation;
+  else
+    return -p_val_z(p, x.get_den());
 }
 
 val_t p_val_q(const mod_t p, const mpq_class& x)
@@ -27,22 +73,129 @@ val_t p_val_q(const mod_t p, const mpq_class& x)
     return -p_val_z(p, x.get_den());
 }
 
-mpz_class p_pow_z(const mod_t p, const u_val_t exp)
+void p_val_row(const Prime<0> p, const MatrixQ& f, const dim_t i,
+               const dim_t j_begin, std::vector<val_t>& valuations)
 {
-  if (exp == std::numeric_limits<val_t>::max())
-    return 0_mpz;
+  mp_limb_t limb = p;
+  mpz_t prime;
+  mpz_roinit_n(prime, &limb, 1);
+  mpz_class remainder;
 
-  mpz_class pow;
-  mpz_ui_pow_ui(pow.get_mpz_t(), p, exp);
-  return pow;
+  MatrixVector<const mpq_class> row = f.row(i);
+  valuations.resize(f.width() - j_begin);
+  for (dim_t j = j_begin; j < f.width(); ++j) {
+    valuations[j - j_begin] = p_val_q(p, row[j], prime, remainder);
+  }
 }
 
-mpq_class p_pow_q(const mod_t p, const val_t exp)
+void p_val_col(const Prime<0> p, const MatrixQ& f, const dim_t j,
+               const dim_t i_begin, std::vector<val_t>& valuations)
 {
-  if (exp >= 0)
-    return p_pow_z(p, static_cast<u_val_t>(exp));
-  else {
-    mpq_class inv_pow = p_pow_z(p, static_cast<u_val_t>(-exp));
-    return 1 / inv_pow;
+  mp_limb_t limb = p;
+  mpz_t prime;
+  mpz_roinit_n(prime, &limb, 1);
+  mpz_class remainder;
+
+  MatrixVector<const mpq_class> col = f.col(j);
+  valuations.resize(f.height() - i_begin);
+  for (dim_t i = i_begin; i < f.height(); ++i) {
+    valuations[i - i_begin] = p_val_q(p, col[i], prime, remainder);
   }
 }
+
+namespace {
+
+// the powers of a single prime. The deques only ever grow at the back, so
+// references to their entries stay valid.
+struct PowerTable
+{
+  std::deque<mpz_class> powers_z;
+  std::deque<mpq_class> powers_q;
+  std::deque<mpq_class> inverses_q;
+  // exponents beyond dense_limit, which would make the dense tables too large.
+  std::map<u_val_t, mpz_class> sparse_z;
+  std::map<val_t, mpq_class> sparse_q;
+};
+
+const u_val_t dense_limit = 1024;
+
+// one table per prime and thread, so that the returned references can not be
+// invalidated by another thread.
+PowerTable& power_table(const mod_t p)
+{
+  static thread_local std::unordered_map<mod_t, PowerTable> tables;
+  static thread_local mod_t last_p = 0;
+  static thread_local PowerTable* last_table = nullptr;
+
+  if (p != last_p) {
+    last_table = &tables[p];
+    last_p = p;
+  }
+  return *last_table;
+}
+
+}  // namespace
+
+const mpz_class& p_pow_z(const mod_t p, const u_val_t exp)
+{
+  static const mpz_class zero = 0;
+  if (exp == std::numeric_limits<val_t>::max()) return zero;
+
+  PowerTable& table = power_table(p);
+
+  if (exp >= dense_limit) {
+    auto it = table.sparse_z.find(exp);
+    if (it == table.sparse_z.end()) {
+      it = table.sparse_z.emplace(exp, mpz_class()).first;
+      mpz_ui_pow_ui(it->second.get_mpz_t(), p, exp);
+    }
+    return it->second;
+  }
+
+  if (table.powers_z.empty()) table.powers_z.emplace_back(1);
+  while (table.powers_z.size() <= exp) {
+    table.powers_z.emplace_back(table.powers_z.back() * p);
+  }
+  return table.powers_z[exp];
+}
+
+const mpq_class& p_pow_q(const mod_t p, const val_t exp)
+{
+  static const mpq_class zero = 0;
+  if (exp == std::numeric_limits<val_t>::max()) return zero;
+
+  PowerTable& table = power_table(p);
+  const u_val_t abs_exp = static_cast<u_val_t>(exp >= 0 ? exp : -exp);
+
+  if (abs_exp >= dense_limit) {
+    auto it = table.sparse_q.find(exp);
+    if (it == table.sparse_q.end()) {
+      mpq_class pow(p_pow_z(p, abs_exp));
+      if (exp < 0) pow = 1 / pow;
+      it = table.sparse_q.emplace(exp, pow).first;
+    }
+    return it->second;
+  }
+
+  std::deque<mpq_class>& powers = exp >= 0 ? table.powers_q : table.inverses_q;
+  while (powers.size() <= abs_exp) {
+    mpq_class pow(p_pow_z(p, powers.size()));
+    if (exp < 0) pow = 1 / pow;
+    powers.push_back(pow);
+  }
+  return powers[abs_exp];
+}
+
+mpq_class mul_p_pow(const Prime<2>, const mpq_class& x, const u_val_t exp)
+{
+  mpq_class result;
+  mpq_mul_2exp(result.get_mpq_t(), x.get_mpq_t(), exp);
+  return result;
+}
+
+mpq_class div_p_pow(const Prime<2>, const mpq_class& x, const u_val_t exp)
+{
+  mpq_class result;
+  mpq_div_2exp(result.get_mpq_t(), x.get_mpq_t(), exp);
+  return result;
+}
@@ -1,12 +1,84 @@
 #pragma once
 
+#include <vector>
+
 #include <gmpxx.h>
 
+#include "matrix.h"
 #include "types.h"
 
+// the prime P as a compile-time constant, for instantiations of the kernels
+// specialized to it. It converts to mod_t, so kernels without a
+// specialization for P accept it as well. Prime<0> holds a prime that is only
+// known at runtime.
+template <mod_t P>
+class Prime
+{
+ public:
+  explicit Prime(const mod_t)
+  {
+  }
+
+  constexpr operator mod_t() const
+  {
+    return P;
+  }
+};
+
+template <>
+class Prime<0>
+{
+ public:
+  explicit Prime(const mod_t p) : p_(p)
+  {
+  }
+
+  operator mod_t() const
+  {
+    return p_;
+  }
+
+ private:
+  mod_t p_;
+};
 
 val_t p_val_z(const mod_t p, const mpz_class& x);
 val_t p_val_q(const mod_t p, const mpq_class& x);
+val_t p_val_z(const Prime<2> p, const mpz_class& x);
+val_t p_val_q(const Prime<2> p, const mpq_class& x);
+
+// the valuations of f(i, j_begin), ..., f(i, f.width() - 1). p is a mod_t
+// or a Prime, and p_val_q picks the kernel for it. Rationals with a prime
+// known only at runtime share one GMP remainder across the row.
+template <typename T, typename PrimeT>
+void p_val_row(const PrimeT p, const Matrix<T>& f, const dim_t i,
+               const dim_t j_begin, std::vector<val_t>& valuations);
+void p_val_row(const Prime<0> p, const MatrixQ& f, const dim_t i,
+               const dim_t j_begin, std::vector<val_t>& valuations);
+
+// the valuations of f(i_begin, j), ..., f(f.height() - 1, j), as p_val_row.
+template <typename T, typename PrimeT>
+void p_val_col(const PrimeT p, const Matrix<T>& f, const dim_t j,
+               const dim_t i_begin, std::vector<val_t>& valuations);
+void p_val_col(const Prime<0> p, const MatrixQ& f, const dim_t j,
+               const dim_t i_begin, std::vector<val_t>& valuations);
+
+// p^exp, looked up in a per-prime table of powers that grows on demand. The
+// references stay valid for the lifetime of the calling thread.
+const mpz_class& p_pow_z(const mod_t p, const u_val_t exp);
+const mpq_class& p_pow_q(const mod_t p, const val_t exp);
+
+// p^exp as an element of T. Coefficient types with a cheaper way to produce
+// powers of p specialize this.
+template <typename T>
+T p_pow(const mod_t p, const u_val_t exp);
+
+// x * p^exp and x / p^exp. For p = 2 and rational x, these are shifts.
+template <typename T>
+T mul_p_pow(const mod_t p, const T& x, const u_val_t exp);
+template <typename T>
+T div_p_pow(const mod_t p, const T& x, const u_val_t exp);
+mpq_class mul_p_pow(const Prime<2> p, const mpq_class& x, const u_val_t exp);
+mpq_class div_p_pow(const Prime<2> p, const mpq_class& x, const u_val_t exp);
 
-mpz_class p_pow_z(const mod_t p, const unsigned long int exp);
-mpq_class p_pow_q(const mod_t p, const val_t exp);
+#include "p_local_impl.h"
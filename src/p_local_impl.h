@@ -0,0 +1,39 @@
+template <typename T, typename PrimeT>
+void p_val_row(const PrimeT p, const Matrix<T>& f, const dim_t i,
+               const dim_t j_begin, std::vector<val_t>& valuations)
+{
+  MatrixVector<const T> row = f.row(i);
+  valuations.resize(f.width() - j_begin);
+  for (dim_t j = j_begin; j < f.width(); ++j) {
+    valuations[j - j_begin] = p_val_q(p, row[j]);
+  }
+}
+
+template <typename T, typename PrimeT>
+void p_val_col(const PrimeT p, const Matrix<T>& f, const dim_t j,
+               const dim_t i_begin, std::vector<val_t>& valuations)
+{
+  MatrixVector<const T> col = f.col(j);
+  valuations.resize(f.height() - i_begin);
+  for (dim_t i = i_begin; i < f.height(); ++i) {
+    valuations[i - i_begin] = p_val_q(p, col[i]);
+  }
+}
+
+template <typename T>
+T p_pow(const mod_t p, const u_val_t exp)
+{
+  return T(p_pow_z(p, exp));
+}
+
+template <typename T>
+T mul_p_pow(const mod_t p, const T& x, const u_val_t exp)
+{
+  return x * p_pow<T>(p, exp);
+}
+
+template <typename T>
+T div_p_pow(const mod_t p, const T& x, const u_val_t exp)
+{
+  return x / p_pow<T>(p, exp);
+}
@@ -0,0 +1,201 @@
+#include "p_local_q.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+
+mod_t PLocalQ::prime_ = 0;
+
+// p^exp for exp >= 0, without going through GMP if it fits into 64 bits.
+static HybridQ power_of_p(const mod_t p, const val_t exp)
+{
+  std::int64_t result = 1;
+  for (val_t i = 0; i < exp; ++i) {
+    if (__builtin_mul_overflow(result, static_cast<std::int64_t>(p), &result))
+      return HybridQ(p_pow_z(p, static_cast<u_val_t>(exp)));
+  }
+  return HybridQ(mpz_class(static_cast<long>(result)));
+}
+
+PLocalQ::Context::Context(const mod_t p) : prev_prime_(prime_)
+{
+  if (p < 2) throw std::logic_error("PLocalQ::Context: invalid prime");
+  prime_ = p;
+}
+
+PLocalQ::Context::~Context()
+{
+  prime_ = prev_prime_;
+}
+
+PLocalQ::PLocalQ(const int x)
+{
+  if (prime_ == 0) throw std::logic_error("PLocalQ::PLocalQ: no prime set");
+  set(HybridQ(x), 0);
+}
+
+PLocalQ::PLocalQ(const mpz_class& x)
+{
+  if (prime_ == 0) throw std::logic_error("PLocalQ::PLocalQ: no prime set");
+  set(HybridQ(x), 0);
+}
+
+PLocalQ::PLocalQ(const mpq_class& x)
+{
+  if (prime_ == 0) throw std::logic_error("PLocalQ::PLocalQ: no prime set");
+  set(HybridQ(x), 0);
+}
+
+PLocalQ PLocalQ::power(const val_t exp)
+{
+  PLocalQ result;
+  result.unit_ = 1;
+  result.valuation_ = exp;
+  return result;
+}
+
+mod_t PLocalQ::prime()
+{
+  return prime_;
+}
+
+void PLocalQ::set(const HybridQ& x, const val_t valuation)
+{
+  if (!x) {
+    unit_ = 0;
+    valuation_ = std::numeric_limits<val_t>::max();
+    return;
+  }
+
+  val_t shift = p_val_q(prime_, x);
+  if (shift > 0)
+    unit_ = x / power_of_p(prime_, shift);
+  else if (shift < 0)
+    unit_ = x * power_of_p(prime_, -shift);
+  else
+    unit_ = x;
+  valuation_ = valuation + shift;
+}
+
+mpq_class PLocalQ::get_mpq() const
+{
+  if (!unit_) return 0;
+
+  return unit_.get_mpq() * p_pow_q(prime_, valuation_);
+}
+
+PLocalQ PLocalQ::operator-() const
+{
+  PLocalQ result(*this);
+  result.unit_ = -unit_;
+  return result;
+}
+
+PLocalQ& PLocalQ::operator+=(const PLocalQ& other)
+{
+  if (!other) return *this;
+  if (!unit_) return *this = other;
+
+  val_t valuation = std::min(valuation_, other.valuation_);
+  HybridQ a = unit_;
+  HybridQ b = other.unit_;
+  if (valuation_ > valuation) a *= power_of_p(prime_, valuation_ - valuation);
+  if (other.valuation_ > valuation)
+    b *= power_of_p(prime_, other.valuation_ - valuation);
+
+  set(a + b, valuation);
+  return *this;
+}
+
+PLocalQ& PLocalQ::operator-=(const PLocalQ& other)
+{
+  return *this += -other;
+}
+
+PLocalQ& PLocalQ::operator*=(const PLocalQ& other)
+{
+  if (!unit_) return *this;
+  if (!other) return *this = other;
+
+  unit_ *= other.unit_;
+  valuation_ += other.valuation_;
+  return *this;
+}
+
+PLocalQ& PLocalQ::operator/=(const PLocalQ& other)
+{
+  if (!other) throw std::logic_error("PLocalQ::operator/=: division by zero");
+  if (!unit_) return *this;
+
+  unit_ /= other.unit_;
+  valuation_ -= other.valuation_;
+  return *this;
+}
+
+PLocalQ operator+(PLocalQ a, const PLocalQ& b)
+{
+  return a += b;
+}
+
+PLocalQ operator-(PLocalQ a, const PLocalQ& b)
+{
+  return a -= b;
+}
+
+PLocalQ operator*(PLocalQ a, const PLocalQ& b)
+{
+  return a *= b;
+}
+
+PLocalQ operator/(PLocalQ a, const PLocalQ& b)
+{
+  return a /= b;
+}
+
+bool operator==(const PLocalQ& a, const PLocalQ& b)
+{
+  return a.valuation() == b.valuation() && a.unit() == b.unit();
+}
+
+bool operator!=(const PLocalQ& a, const PLocalQ& b)
+{
+  return !(a == b);
+}
+
+std::ostream& operator<<(std::ostream& stream, const PLocalQ& x)
+{
+  return stream << x.get_mpq();
+}
+
+val_t p_val_q(const mod_t p, const PLocalQ& x)
+{
+  if (p != PLocalQ::prime())
+    throw std::logic_error("p_val_q: prime does not match PLocalQ::prime()");
+  return x.valuation();
+}
+
+template <>
+PLocalQ p_pow<PLocalQ>(const mod_t p, const u_val_t exp)
+{
+  if (p != PLocalQ::prime())
+    throw std::logic_error("p_pow: prime does not match PLocalQ::prime()");
+  if (exp == static_cast<u_val_t>(std::numeric_limits<val_t>::max()))
+    return PLocalQ();
+  return PLocalQ::power(static_cast<val_t>(exp));
+}
+
+Matrix<PLocalQ> to_p_local_q(const MatrixQ& f)
+{
+  return matrix_cast<PLocalQ>(f);
+}
+
+MatrixQ to_rational(const Matrix<PLocalQ>& f)
+{
+  MatrixQ result(f.height(), f.width());
+  for (dim_t i = 0; i < f.height(); ++i) {
+    for (dim_t j = 0; j < f.width(); ++j) {
+      result(i, j) = f(i, j).get_mpq();
+    }
+  }
+  return result;
+}
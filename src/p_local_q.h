@@ -0,0 +1,92 @@
+#pragma once
+
+#include <iostream>
+#include <limits>
+
+#include <gmpxx.h>
+
+#include "hybrid_q.h"
+#include "matrix.h"
+#include "p_local.h"
+#include "types.h"
+
+// A rational number x, stored as the pair (u, v) with x = u * p^v, where u is
+// a p-local unit. Reading the valuation is O(1), and products and quotients
+// only multiply the units and add the exponents.
+// The prime is shared by all elements and installed for the lifetime of a
+// PLocalQ::Context.
+class PLocalQ
+{
+ public:
+  class Context
+  {
+   public:
+    Context(const mod_t p);
+    ~Context();
+
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+
+   private:
+    mod_t prev_prime_;
+  };
+
+  PLocalQ() = default;
+  PLocalQ(const int x);
+  explicit PLocalQ(const mpz_class& x);
+  explicit PLocalQ(const mpq_class& x);
+
+  // the element p^exp.
+  static PLocalQ power(const val_t exp);
+  static mod_t prime();
+
+  explicit operator bool() const
+  {
+    return static_cast<bool>(unit_);
+  }
+
+  inline const HybridQ& unit() const
+  {
+    return unit_;
+  }
+
+  inline val_t valuation() const
+  {
+    return valuation_;
+  }
+
+  mpq_class get_mpq() const;
+
+  PLocalQ operator-() const;
+  PLocalQ& operator+=(const PLocalQ& other);
+  PLocalQ& operator-=(const PLocalQ& other);
+  PLocalQ& operator*=(const PLocalQ& other);
+  PLocalQ& operator/=(const PLocalQ& other);
+
+ private:
+  // sets *this to x * p^valuation for an arbitrary x.
+  void set(const HybridQ& x, const val_t valuation);
+
+  static mod_t prime_;
+
+  // zero iff the number is zero, in which case valuation_ is the maximal
+  // value, as for p_val_q.
+  HybridQ unit_;
+  val_t valuation_ = std::numeric_limits<val_t>::max();
+};
+
+PLocalQ operator+(PLocalQ a, const PLocalQ& b);
+PLocalQ operator-(PLocalQ a, const PLocalQ& b);
+PLocalQ operator*(PLocalQ a, const PLocalQ& b);
+PLocalQ operator/(PLocalQ a, const PLocalQ& b);
+bool operator==(const PLocalQ& a, const PLocalQ& b);
+bool operator!=(const PLocalQ& a, const PLocalQ& b);
+std::ostream& operator<<(std::ostream& stream, const PLocalQ& x);
+
+val_t p_val_q(const mod_t p, const PLocalQ& x);
+
+template <>
+PLocalQ p_pow<PLocalQ>(const mod_t p, const u_val_t exp);
+
+Matrix<PLocalQ> to_p_local_q(const MatrixQ& f);
+MatrixQ to_rational(const Matrix<PLocalQ>& f);
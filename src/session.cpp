@@ -1,9 +1,14 @@
 #include "session.h"
+#include <algorithm>
+#include <cstdio>
 #include <sstream>
 
+#include "snapshot.h"
+
 Session::Session(mod_t prime, std::string ranks_path, std::string v_inclusions_path,
-                 std::string r_operations_path_prefix, dim_t max_deg)
-  : sequence_(prime)
+                 std::string r_operations_path_prefix, dim_t max_deg,
+                 Coefficients coefficients)
+  : sequence_(prime), coefficients_(coefficients)
 {
   parse_ranks(ranks_path, max_deg);
   parse_v_inclusions(v_inclusions_path, max_deg);
@@ -38,7 +43,13 @@ dim_t Session::get_monomial_rank(deg_t p) const
   }
 }
 
-MatrixQ Session::get_v_inclusion(deg_t p) const
+static const SparseMatrixQ& empty_sparse_matrix()
+{
+  static const SparseMatrixQ empty(0, 0);
+  return empty;
+}
+
+const SparseMatrixQ& Session::get_v_inclusion(deg_t p) const
 {
   if (p < 0) throw std::logic_error("Session::get_v_inclusion: p<0");
 
@@ -53,11 +64,12 @@ MatrixQ Session::get_v_inclusion(deg_t p) const
     }
     return v_inclusions_[p_u / 2 -1];
   } else {
-    return MatrixQ(0, 0);
+    return empty_sparse_matrix();
   }
 }
 
-MatrixQ Session::get_r_operations(deg_t source, deg_t target, dim_t index) const
+const SparseMatrixQ& Session::get_r_operations(deg_t source, deg_t target,
+                                               dim_t index) const
 {
   auto r_operations_it = r_operations_.find(std::make_tuple(source, target, index));
   if(r_operations_it == r_operations_.end()){
@@ -103,7 +115,7 @@ void Session::parse_v_inclusions(std::string path, dim_t max_deg)
           "Session::parse_v_inclusions: file syntax error in file " + path +
           ". Is max_deg bigger than the amount of matrices provided?");
     }
-    v_inclusions_.emplace_back(matrix);
+    v_inclusions_.emplace_back(SparseMatrixQ(matrix));
   }
 }
 
@@ -130,15 +142,17 @@ void Session::parse_r_operations(std::string path, dim_t domain_deg)
         throw std::logic_error(
             "Session::parse_r_operations: file syntax error in file " + path);
       }
-      r_operations_.emplace(std::make_tuple(domain_deg, target_deg, j), matrix);
+      r_operations_.emplace(std::make_tuple(domain_deg, target_deg, j),
+                            SparseMatrixQ(matrix));
     }
   }
 }
 
 void Session::step()
 {
+  // the coefficients of this session, only while it computes.
+  CoefficientsScope coefficients(coefficients_);
   generate_group_tasks();
-  autosolve_tasks();
 
   sequence_.set_bounds(current_q_ + 1, 1, current_q_ + 1);
 
@@ -150,24 +164,119 @@ void Session::step()
       generate_differential_tasks_pq_deg(p + r+1, static_cast<dim_t>(q - r + 1), r);
 
       generate_differential_tasks_pq_deg(p + r +2 , static_cast<dim_t>(q - r + 1), r);
-
-      autosolve_tasks();
-      user_solve_tasks();
-      // have to do them one after another, because they depend on each other.
     }
   }
 
   generate_extension_tasks();
 
-  autosolve_tasks();
-  user_solve_tasks();
+  // the scheduler orders the tasks by what they read and write.
+  solve_tasks();
   current_q_++;
+
+  if (!checkpoint_path_.empty()) save_checkpoint(checkpoint_path_);
+}
+
+// the first bytes of every checkpoint.
+static const char CHECKPOINT_MAGIC[8] = {'A', 'K', 'S', 'S',
+                                         'S', 'N', 'A', 'P'};
+
+void Session::set_checkpoint_path(std::string path)
+{
+  checkpoint_path_ = path;
+}
+
+void Session::save_checkpoint(std::ostream& stream) const
+{
+  stream.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  write_uint(stream, SNAPSHOT_VERSION);
+  write_int(stream, current_q_);
+  sequence_.save(stream);
+  write_uint(stream, task_list_.size() + scheduler_.size());
+  for (const std::unique_ptr<Task>& task : task_list_) {
+    task->save(stream);
+  }
+  for (const std::unique_ptr<Task>& task : scheduler_.tasks()) {
+    task->save(stream);
+  }
+}
+
+void Session::save_checkpoint(const std::string& path) const
+{
+  // written next to path first, so that a crash while writing leaves the
+  // last checkpoint intact.
+  const std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      throw std::logic_error("Session::save_checkpoint: Cannot open " +
+                             temporary_path);
+    }
+    save_checkpoint(file);
+    file.flush();
+    if (!file) {
+      throw std::logic_error("Session::save_checkpoint: Cannot write " +
+                             temporary_path);
+    }
+  }
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    throw std::logic_error("Session::save_checkpoint: Cannot replace " + path);
+  }
+}
+
+void Session::load_checkpoint(std::istream& stream)
+{
+  char magic[sizeof(CHECKPOINT_MAGIC)];
+  stream.read(magic, sizeof(magic));
+  if (stream.gcount() != sizeof(magic) ||
+      !std::equal(magic, magic + sizeof(magic), CHECKPOINT_MAGIC)) {
+    throw std::logic_error("Session::load_checkpoint: Not a checkpoint.");
+  }
+  if (read_uint(stream) != SNAPSHOT_VERSION) {
+    throw std::logic_error(
+        "Session::load_checkpoint: Unsupported checkpoint version.");
+  }
+
+  const deg_t current_q = read_int(stream);
+  SpectralSequence sequence = SpectralSequence::load(stream);
+  if (sequence.get_prime() != sequence_.get_prime()) {
+    throw std::logic_error(
+        "Session::load_checkpoint: Checkpoint is for a different prime.");
+  }
+
+  std::vector<std::unique_ptr<Task>> tasks;
+  const dim_t task_count = read_uint(stream);
+  for (dim_t i = 0; i < task_count; ++i) {
+    tasks.push_back(Task::load(*this, stream));
+  }
+
+  current_q_ = current_q;
+  sequence_ = std::move(sequence);
+  task_list_.clear();
+  scheduler_.clear();
+  for (std::unique_ptr<Task>& task : tasks) {
+    scheduler_.add(std::move(task));
+  }
+}
+
+void Session::load_checkpoint(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::logic_error("Session::load_checkpoint: Cannot open " + path);
+  }
+  load_checkpoint(file);
+}
+
+deg_t Session::get_current_q() const
+{
+  return current_q_;
 }
 
 void Session::generate_group_tasks()
 {
   for(deg_t p =1; p<= 2*current_q_+2; p++){
-    task_list_.emplace_back(new GroupTask(*this, p, static_cast<deg_t>(current_q_-(p-1)/2)));
+    scheduler_.add(std::unique_ptr<Task>(new GroupTask(
+        *this, p, static_cast<deg_t>(current_q_ - (p - 1) / 2))));
   }
 //  task_list_.emplace_back(new GroupTask(*this, 1, current_q_));
 //  task_list_.emplace_back(new GroupTask(*this, 2, current_q_));
@@ -204,8 +313,8 @@ void Session::generate_differential_tasks_pq_deg(dim_t p, dim_t q, dim_t r){
   }
 
   for(deg_t s = min; s<=max; s++){
-    task_list_.emplace_back(new DifferentialTask(
-            *this, TrigradedIndex(p,q,s), r));
+    scheduler_.add(std::unique_ptr<Task>(new DifferentialTask(
+            *this, TrigradedIndex(p,q,s), r)));
   }
 
 }
@@ -213,19 +322,17 @@ void Session::generate_differential_tasks_pq_deg(dim_t p, dim_t q, dim_t r){
 void Session::generate_extension_tasks()
 {
   for (deg_t s = 1; s <= current_q_ + 1; s++) {
-    task_list_.emplace_back(new ExtensionTask(*this, current_q_ + 1, s));
+    scheduler_.add(
+        std::unique_ptr<Task>(new ExtensionTask(*this, current_q_ + 1, s)));
   }
 }
 
-void Session::autosolve_tasks()
+void Session::solve_tasks()
 {
-  auto task_it = task_list_.begin();
-  while (task_it != task_list_.end()) {
-    if ((*task_it)->autosolve()) {
-      task_it = task_list_.erase(task_it);
-    } else {
-      task_it++;
-    }
+  for (;;) {
+    task_list_ = scheduler_.run(sequence_);
+    if (task_list_.empty()) return;
+    user_solve_tasks();
   }
 }
 
@@ -355,19 +462,19 @@ void Session::display_eab(std::size_t a, std::size_t b, std::size_t p, std::size
   std::cout << "Group: ";
   eab.group.print(std::cout,sequence_.get_prime());
   std::cout << "\n";
-  MatrixQ ker_inclusion = sequence_.get_inclusion(TrigradedIndex(p,q,s),a);
+  const MatrixQ& ker_inclusion = sequence_.get_inclusion(TrigradedIndex(p,q,s),a);
   MatrixQ representatives = ker_inclusion * eab.maps_from[1]; //eab.maps_from[1] has columns representatives for generators.
   std::cout << "with generators represented by:\n" << representatives;
 }
 
 void Session::display_e(std::size_t r, std::size_t p, std::size_t q, std::size_t s) {
-  AbelianGroup e = sequence_.get_e_ab(TrigradedIndex(p,q,s),r,r).group;
+  AbelianGroup e = sequence_.get_e_ab_group(TrigradedIndex(p,q,s),r,r);
   std::cout << "Group: ";
   e.print(std::cout,sequence_.get_prime());
   std::cout << "\n";
 }
 void Session::display_differential(std::size_t r, std::size_t p, std::size_t q, std::size_t s) {
-  MatrixQ d = sequence_.get_diff_from(TrigradedIndex(p,q,s),r);
+  DifferentialRef d = sequence_.get_diff_from(TrigradedIndex(p,q,s),r);
   std::cout << d;
 }
 
@@ -9,8 +9,10 @@
 #include <cstdlib>
 
 #include "parser.h"
+#include "sparse_matrix.h"
 #include "spectral_sequence.h"
 #include "task.h"
+#include "task_scheduler.h"
 #include "types.h"
 
 class Task;
@@ -19,13 +21,28 @@ class Session
 {
  public:
   Session(mod_t prime, std::string ranks_path, std::string v_inclusions_path,
-          std::string r_operations_path_prefix, dim_t max_deg);
+          std::string r_operations_path_prefix, dim_t max_deg,
+          Coefficients coefficients = Coefficients::rational);
   void step();
 
+  // once set, a checkpoint is written to path after every step, so that a
+  // run can be resumed from the last finished q with load_checkpoint.
+  void set_checkpoint_path(std::string path);
+  // a binary snapshot of the spectral sequence, the current q and the
+  // pending tasks, see snapshot.h.
+  void save_checkpoint(std::ostream& stream) const;
+  void save_checkpoint(const std::string& path) const;
+  // replaces that state by a snapshot of a session with the same prime. The
+  // ranks, inclusions and operations are the ones read by the constructor.
+  void load_checkpoint(std::istream& stream);
+  void load_checkpoint(const std::string& path);
+  deg_t get_current_q() const;
+
   SpectralSequence& get_sequence();
   dim_t get_monomial_rank(deg_t p) const;
-  MatrixQ get_v_inclusion(deg_t p) const;
-  MatrixQ get_r_operations(deg_t source, deg_t target, dim_t index) const;
+  const SparseMatrixQ& get_v_inclusion(deg_t p) const;
+  const SparseMatrixQ& get_r_operations(deg_t source, deg_t target,
+                                        dim_t index) const;
 
   void matrix_file_dialog(dim_t width, dim_t height, std::string filename, std::string text);
   MatrixQ read_matrix_file(dim_t height, dim_t width, std::string filename);
@@ -38,7 +55,9 @@ class Session
   void generate_differential_tasks(dim_t r);
   void generate_differential_tasks_pq_deg(dim_t p, dim_t q, dim_t r);
   void generate_extension_tasks();
-  void autosolve_tasks();
+  // runs the scheduled tasks, and asks the user for the ones that cannot
+  // be autosolved, until all are solved.
+  void solve_tasks();
   void user_solve_tasks();
 
   //IO Stuff
@@ -54,14 +73,20 @@ class Session
 
   // shell
   SpectralSequence sequence_;
+  Coefficients coefficients_;
 
   deg_t current_q_;
 
   std::vector<dim_t> ranks_;
   // at (p, k, i), we find the i'th operation from deg p to deg k.
 
-  std::map<std::tuple<deg_t, deg_t, dim_t>, MatrixQ> r_operations_;// <domain, codomain, number>
-  std::vector<MatrixQ> v_inclusions_;
+  // r-operations and v-inclusions are mostly zero, so they are kept sparse.
+  std::map<std::tuple<deg_t, deg_t, dim_t>, SparseMatrixQ> r_operations_;// <domain, codomain, number>
+  std::vector<SparseMatrixQ> v_inclusions_;
 
+  TaskScheduler scheduler_;
+  // the tasks that the user has to solve.
   std::list<std::unique_ptr<Task>> task_list_;
+
+  std::string checkpoint_path_;
 };
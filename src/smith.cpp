@@ -0,0 +1,25 @@
+#include "smith.h"
+
+#include <atomic>
+
+static std::atomic<SmithEngine> smith_engine_(SmithEngine::dense);
+
+void set_smith_engine(const SmithEngine engine)
+{
+  smith_engine_ = engine;
+}
+
+SmithEngine get_smith_engine()
+{
+  return smith_engine_;
+}
+
+SmithEngineScope::SmithEngineScope(const SmithEngine engine)
+    : prev_engine_(smith_engine_.exchange(engine))
+{
+}
+
+SmithEngineScope::~SmithEngineScope()
+{
+  smith_engine_ = prev_engine_;
+}
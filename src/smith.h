@@ -1,11 +1,137 @@
 #pragma once
 
+#include <vector>
+
 #include "matrix.h"
 #include "types.h"
 
+// a sequence of the basis changes of basis_vectors_add, basis_vectors_mul and
+// basis_vectors_swap, recorded so that it can be applied later, and only to
+// the maps that are needed.
 template <typename T>
+class BasisChange
+{
+ public:
+  void add(const dim_t i1, const dim_t i2, const T& lambda);
+  void mul(const dim_t i, const T& lambda);
+  void swap(const dim_t i1, const dim_t i2);
+
+  // appends the operations of other, on the basis vectors offset,
+  // offset + 1, ... instead of 0, 1, ....
+  void append(const BasisChange<T>& other, const dim_t offset);
+
+  inline dim_t size() const
+  {
+    return operations_.size();
+  }
+
+  // changes the basis of the group for the maps to and from it, as the
+  // basis_vectors_* calls would have. The operations are replayed on blocks
+  // of basis_change_block columns of the maps to the group and rows of the
+  // maps from it, which are distributed over the threads of parallel_for, so
+  // the maps have to be distinct.
+  void apply(MatrixRefList<T>& to, MatrixRefList<T>& from) const;
+
+ private:
+  enum class Kind { add, mul, swap };
+
+  // for add and mul, to_factor and from_factor are the factors of the row
+  // operation on maps to the group and of the column operation on maps from
+  // it.
+  struct Operation
+  {
+    Kind kind;
+    dim_t i1;
+    dim_t i2;
+    T to_factor;
+    T from_factor;
+  };
+
+  void apply_to(Matrix<T>& f, const dim_t j_begin, const dim_t j_end) const;
+  void apply_from(Matrix<T>& f, const dim_t i_begin, const dim_t i_end) const;
+
+  std::vector<Operation> operations_;
+};
+
+const dim_t basis_change_block = 32;
+
+// a step of the reductions below distributes its row and column eliminations
+// over the threads of parallel_for if they touch at least this many entries.
+const dim_t smith_parallel_threshold = 1 << 12;
+
+// smith_reduce_p reduces dense matrices with at least smith_block_threshold
+// rows and columns with block_smith_reduce_p, which takes up to
+// smith_block_size pivots per step.
+const dim_t smith_block_threshold = 96;
+const dim_t smith_block_size = 32;
+
+// The algorithm smith_reduce_p uses.
+// dense: elimination on the dense matrix, taking the first pivot of minimal
+//   valuation, or blocks of pivots for large matrices.
+// sparse: elimination on sparse rows, taking among the pivots of minimal
+//   valuation one with the least fill-in, see sparse_smith_reduce_p. The
+//   bases differ from the dense ones, the groups do not.
+enum class SmithEngine { dense, sparse };
+
+void set_smith_engine(const SmithEngine engine);
+SmithEngine get_smith_engine();
+
+// uses engine for as long as it lives and restores the previous engine when
+// destroyed.
+class SmithEngineScope
+{
+ public:
+  explicit SmithEngineScope(const SmithEngine engine);
+  ~SmithEngineScope();
+
+  SmithEngineScope(const SmithEngineScope&) = delete;
+  SmithEngineScope& operator=(const SmithEngineScope&) = delete;
+
+ private:
+  SmithEngine prev_engine_;
+};
+
+// P fixes the prime at compile time, see Prime; P = 0 uses the runtime p.
+template <typename T, mod_t P = 0>
 void smith_reduce_p(const mod_t p, Matrix<T>& f, MatrixRefList<T>& to_X,
                     MatrixRefList<T>& from_X, MatrixRefList<T>& to_Y,
                     MatrixRefList<T>& from_Y);
 
+// reduces f, a map X -> Y, and records the basis changes of X and Y instead
+// of applying them to maps to and from X and Y.
+template <typename T, mod_t P = 0>
+void smith_reduce_p(const mod_t p, Matrix<T>& f, BasisChange<T>& X_change,
+                    BasisChange<T>& Y_change);
+
+// smith_reduce_p one pivot at a time, the first one of minimal valuation.
+// This is the reference for the other algorithms.
+template <typename T, mod_t P = 0>
+void dense_smith_reduce_p(const mod_t p, Matrix<T>& f,
+                          BasisChange<T>& X_change, BasisChange<T>& Y_change);
+
+// smith_reduce_p in steps of up to smith_block_size pivots of the minimal
+// valuation v whose block B is p^v times an invertible matrix. B is reduced
+// by dense_smith_reduce_p, and the other entries of the rows and columns of
+// the pivots are eliminated at once: with f = [B C; D E], E becomes the
+// Schur complement E - (D / p^v) C, a single matrix product. The last
+// smith_block_size rows or columns are left to dense_smith_reduce_p. The
+// bases differ from the dense ones, the groups do not.
+template <typename T, mod_t P = 0>
+void block_smith_reduce_p(const mod_t p, Matrix<T>& f,
+                          BasisChange<T>& X_change, BasisChange<T>& Y_change);
+
+// smith_reduce_p on the nonzero entries of f only. Among the pivots of
+// minimal valuation it takes one with the least Markowitz cost
+// (r - 1)(c - 1), where r and c count the nonzero entries in its row and
+// column, which bounds the fill-in of the step.
+template <typename T, mod_t P = 0>
+void sparse_smith_reduce_p(const mod_t p, Matrix<T>& f,
+                           BasisChange<T>& X_change, BasisChange<T>& Y_change);
+
+// the valuations of the diagonal entries of the Smith normal form of f, in
+// increasing order and without the zero entries. f is reduced without
+// keeping track of the basis changes.
+template <typename T, mod_t P = 0>
+std::vector<val_t> smith_valuations_p(const mod_t p, Matrix<T> f);
+
 #include "smith_impl.h"
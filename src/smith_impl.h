@@ -1,62 +1,728 @@
+#include <algorithm>
+#include <cstddef>
 #include <exception>
 #include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
 
 #include "p_local.h"
+#include "thread_pool.h"
+
+// the valuations of the entries of a matrix under reduction, and for every
+// row the first column of minimal valuation, so that finding a pivot does not
+// compute valuations. After the pivot of step d is swapped to (d, d), only
+// rows and columns d + 1, ... are tracked, and only the rows that the
+// reduction changes have to be updated.
+template <typename T, mod_t P>
+class ValuationShadow
+{
+ public:
+  ValuationShadow(const Prime<P> prime, const Matrix<T>& f)
+      : prime_(prime), width_(f.width()),
+        valuations_(f.height() * f.width()), row_min_(f.height()),
+        row_min_col_(f.height())
+  {
+    for (dim_t i = 0; i < f.height(); ++i) {
+      update(f, i, 0);
+    }
+  }
+
+  // the first entry of minimal valuation in rows and columns d, d + 1, ...,
+  // in row-major order.
+  void pivot(const dim_t d, dim_t& i_min, dim_t& j_min,
+             val_t& min_valuation) const
+  {
+    min_valuation = std::numeric_limits<val_t>::max();
+    for (dim_t i = d; i < row_min_.size(); ++i) {
+      if (row_min_[i] < min_valuation) {
+        i_min = i;
+        j_min = row_min_col_[i];
+        min_valuation = row_min_[i];
+      }
+    }
+  }
+
+  // swaps row i_min with row d and column j_min with column d.
+  void swap(const dim_t d, const dim_t i_min, const dim_t j_min)
+  {
+    using std::swap;
+
+    std::swap_ranges(valuations_.begin() + row(i_min),
+                     valuations_.begin() + row(i_min + 1),
+                     valuations_.begin() + row(d));
+    swap(row_min_[i_min], row_min_[d]);
+    swap(row_min_col_[i_min], row_min_col_[d]);
+
+    for (dim_t i = d + 1; i < row_min_.size(); ++i) {
+      swap(valuations_[row(i) + j_min], valuations_[row(i) + d]);
+
+      const dim_t j = row_min_col_[i];
+      if (j == d || j == j_min)
+        find_row_min(i, d + 1);
+      else if (j_min < j && valuations_[row(i) + j_min] == row_min_[i])
+        row_min_col_[i] = j_min;
+    }
+  }
+
+  // recomputes the valuations of row i of f in columns j_begin, .... Calls
+  // for different rows may run concurrently.
+  void update(const Matrix<T>& f, const dim_t i, const dim_t j_begin)
+  {
+    static thread_local std::vector<val_t> scratch;
+    p_val_row(prime_, f, i, j_begin, scratch);
+    std::copy(scratch.begin(), scratch.end(),
+              valuations_.begin() + row(i) + j_begin);
+    find_row_min(i, j_begin);
+  }
+
+ private:
+  inline std::ptrdiff_t row(const dim_t i) const
+  {
+    return static_cast<std::ptrdiff_t>(i * width_);
+  }
+
+  void find_row_min(const dim_t i, const dim_t j_begin)
+  {
+    row_min_[i] = std::numeric_limits<val_t>::max();
+    row_min_col_[i] = width_;
+    for (dim_t j = j_begin; j < width_; ++j) {
+      if (valuations_[row(i) + j] < row_min_[i]) {
+        row_min_[i] = valuations_[row(i) + j];
+        row_min_col_[i] = j;
+      }
+    }
+  }
+
+  const Prime<P> prime_;
+  dim_t width_;
+  std::vector<val_t> valuations_;
+  std::vector<val_t> row_min_;
+  std::vector<dim_t> row_min_col_;
+};
+
+// runs f(0), ..., f(n - 1), on the threads of parallel_for if they touch at
+// least smith_parallel_threshold entries in total.
+template <typename F>
+void smith_for(const dim_t n, const dim_t entries, const F& f)
+{
+  if (entries < smith_parallel_threshold) {
+    for (dim_t k = 0; k < n; ++k) {
+      f(k);
+    }
+  } else {
+    parallel_for(0, n, f);
+  }
+}
+
+template <typename T>
+void BasisChange<T>::add(const dim_t i1, const dim_t i2, const T& lambda)
+{
+  operations_.push_back({Kind::add, i1, i2, -lambda, lambda});
+}
+
+template <typename T>
+void BasisChange<T>::mul(const dim_t i, const T& lambda)
+{
+  operations_.push_back({Kind::mul, i, i, 1 / lambda, lambda});
+}
 
 template <typename T>
+void BasisChange<T>::swap(const dim_t i1, const dim_t i2)
+{
+  operations_.push_back({Kind::swap, i1, i2, T(0), T(0)});
+}
+
+template <typename T>
+void BasisChange<T>::append(const BasisChange<T>& other, const dim_t offset)
+{
+  operations_.reserve(operations_.size() + other.operations_.size());
+  for (const Operation& op : other.operations_) {
+    operations_.push_back(op);
+    operations_.back().i1 += offset;
+    operations_.back().i2 += offset;
+  }
+}
+
+template <typename T>
+void BasisChange<T>::apply_to(Matrix<T>& f, const dim_t j_begin,
+                              const dim_t j_end) const
+{
+  using std::swap;
+
+  for (const Operation& op : operations_) {
+    for (dim_t j = j_begin; j < j_end; ++j) {
+      switch (op.kind) {
+        case Kind::add:
+          mul_add(f(op.i1, j), op.to_factor, f(op.i2, j));
+          break;
+        case Kind::mul:
+          f(op.i1, j) *= op.to_factor;
+          break;
+        case Kind::swap:
+          swap(f(op.i1, j), f(op.i2, j));
+          break;
+      }
+    }
+  }
+}
+
+template <typename T>
+void BasisChange<T>::apply_from(Matrix<T>& f, const dim_t i_begin,
+                                const dim_t i_end) const
+{
+  using std::swap;
+
+  for (const Operation& op : operations_) {
+    for (dim_t i = i_begin; i < i_end; ++i) {
+      switch (op.kind) {
+        case Kind::add:
+          mul_add(f(i, op.i2), op.from_factor, f(i, op.i1));
+          break;
+        case Kind::mul:
+          f(i, op.i1) *= op.from_factor;
+          break;
+        case Kind::swap:
+          swap(f(i, op.i1), f(i, op.i2));
+          break;
+      }
+    }
+  }
+}
+
+template <typename T>
+void BasisChange<T>::apply(MatrixRefList<T>& to,
+                           MatrixRefList<T>& from) const
+{
+  if (operations_.empty()) return;
+
+  // the blocks of all maps, as (map, first column or row) pairs; the maps
+  // to the group come first.
+  std::vector<std::pair<dim_t, dim_t>> blocks;
+  for (dim_t k = 0; k < to.size(); ++k) {
+    for (dim_t j = 0; j < to[k].get().width(); j += basis_change_block) {
+      blocks.emplace_back(k, j);
+    }
+  }
+  for (dim_t k = 0; k < from.size(); ++k) {
+    for (dim_t i = 0; i < from[k].get().height(); i += basis_change_block) {
+      blocks.emplace_back(to.size() + k, i);
+    }
+  }
+
+  // every block is changed by a single thread, in the recorded order.
+  parallel_for(0, blocks.size(), [&](const dim_t b) {
+    const dim_t k = blocks[b].first;
+    const dim_t begin = blocks[b].second;
+
+    if (k < to.size()) {
+      Matrix<T>& f = to[k];
+      apply_to(f, begin, std::min(begin + basis_change_block, f.width()));
+    } else {
+      Matrix<T>& f = from[k - to.size()];
+      apply_from(f, begin, std::min(begin + basis_change_block, f.height()));
+    }
+  });
+}
+
+template <typename T, mod_t P>
 void smith_reduce_p(const mod_t p, Matrix<T>& f, MatrixRefList<T>& to_X,
                     MatrixRefList<T>& from_X, MatrixRefList<T>& to_Y,
                     MatrixRefList<T>& from_Y)
 {
-  from_X.emplace_back(f);
-  to_Y.emplace_back(f);
+  BasisChange<T> X_change;
+  BasisChange<T> Y_change;
+  smith_reduce_p<T, P>(p, f, X_change, Y_change);
 
-  mpq_class lambda;
+  X_change.apply(to_X, from_X);
+  Y_change.apply(to_Y, from_Y);
+}
+
+template <typename T, mod_t P>
+void smith_reduce_p(const mod_t p, Matrix<T>& f, BasisChange<T>& X_change,
+                    BasisChange<T>& Y_change)
+{
+  if (get_smith_engine() == SmithEngine::sparse)
+    sparse_smith_reduce_p<T, P>(p, f, X_change, Y_change);
+  else if (std::min(f.height(), f.width()) >= smith_block_threshold)
+    block_smith_reduce_p<T, P>(p, f, X_change, Y_change);
+  else
+    dense_smith_reduce_p<T, P>(p, f, X_change, Y_change);
+}
+
+template <typename T, mod_t P>
+void dense_smith_reduce_p(const mod_t p, Matrix<T>& f,
+                          BasisChange<T>& X_change, BasisChange<T>& Y_change)
+{
+  const Prime<P> prime(p);
+
+  // f is changed right away, as a map from X and as a map to Y.
+  MatrixRefList<T> f_ref = {f};
+  MatrixRefList<T> none;
+
+  T lambda;
+  ValuationShadow<T, P> shadow(prime, f);
+  std::vector<dim_t> changed_rows;
+  // the rows and columns to eliminate in a step, and their factors. They are
+  // eliminated independently and recorded in order afterwards, so the result
+  // does not depend on the number of threads.
+  std::vector<char> eliminate_row(f.height());
+  std::vector<char> eliminate_col(f.width());
+  std::vector<T> row_factors(f.height());
+  std::vector<T> col_factors(f.width());
   for (dim_t diagonal_block_size = 0;
        diagonal_block_size < std::min(f.height(), f.width());
        ++diagonal_block_size) {
     dim_t i_min = 0;
     dim_t j_min = 0;
-    T min_value;
-    val_t min_valuation = 0;
+    val_t min_valuation;
+    shadow.pivot(diagonal_block_size, i_min, j_min, min_valuation);
+
+    // zero entries have maximal valuation.
+    if (min_valuation == std::numeric_limits<val_t>::max()) break;
+    if (min_valuation < 0)
+      throw std::logic_error(
+          "dense_smith_reduce_p: matrix entry has negative valuation");
+
+    // the pivot, row i_min and column j_min only change in the swaps below.
+    const T min_value = f(i_min, j_min);
+    MatrixVector<T> pivot_col = f.col(j_min);
+    MatrixVector<T> pivot_row = f.row(i_min);
 
+    const dim_t rows = f.height() - diagonal_block_size;
+    smith_for(rows, rows * f.width(), [&](const dim_t k) {
+      const dim_t i = diagonal_block_size + k;
+      eliminate_row[i] = i != i_min && pivot_col[i];
+      if (!eliminate_row[i]) return;
+      row_factors[i] = pivot_col[i] / min_value;
+      f.row_add(i_min, i, -row_factors[i]);
+    });
+
+    // the column operations below only change the rows with a nonzero entry
+    // in column j_min, which the row operations leave at row i_min.
+    changed_rows.clear();
     for (dim_t i = diagonal_block_size; i < f.height(); ++i) {
-      for (dim_t j = diagonal_block_size; j < f.width(); ++j) {
-        if (f(i, j)) {
-          if (!min_value || p_val_q(p, f(i, j)) < min_valuation) {
-            i_min = i;
-            j_min = j;
-            min_value = f(i, j);
-            min_valuation = p_val_q(p, min_value);
-          }
+      if (!eliminate_row[i]) continue;
+      Y_change.add(i, i_min, row_factors[i]);
+      changed_rows.push_back(i == diagonal_block_size ? i_min : i);
+    }
+
+    const dim_t cols = f.width() - diagonal_block_size;
+    smith_for(cols, f.height() * cols, [&](const dim_t k) {
+      const dim_t j = diagonal_block_size + k;
+      eliminate_col[j] = j != j_min && pivot_row[j];
+      if (!eliminate_col[j]) return;
+      col_factors[j] = -pivot_row[j] / min_value;
+      f.col_add(j_min, j, col_factors[j]);
+    });
+
+    for (dim_t j = diagonal_block_size; j < f.width(); ++j) {
+      if (eliminate_col[j]) X_change.add(j_min, j, col_factors[j]);
+    }
+
+    Y_change.swap(i_min, diagonal_block_size);
+    basis_vectors_swap(f_ref, none, i_min, diagonal_block_size);
+    X_change.swap(j_min, diagonal_block_size);
+    basis_vectors_swap(none, f_ref, j_min, diagonal_block_size);
+    shadow.swap(diagonal_block_size, i_min, j_min);
+    smith_for(changed_rows.size(), changed_rows.size() * f.width(),
+              [&](const dim_t k) {
+                shadow.update(f, changed_rows[k], diagonal_block_size + 1);
+              });
+
+    lambda = p_pow<T>(prime, static_cast<u_val_t>(min_valuation)) / min_value;
+    X_change.mul(diagonal_block_size, lambda);
+    basis_vectors_mul(none, f_ref, diagonal_block_size, lambda);
+  }
+}
+
+template <typename T, mod_t P>
+void block_smith_reduce_p(const mod_t p, Matrix<T>& f,
+                          BasisChange<T>& X_change, BasisChange<T>& Y_change)
+{
+  const Prime<P> prime(p);
+  MatrixRefList<T> none;
+
+  std::vector<val_t> col_min;
+  std::vector<dim_t> panel;
+  std::vector<char> pivot_found;
+  std::vector<dim_t> pivot_rows;
+  std::vector<dim_t> pivot_cols;
+  dim_t d = 0;
+  while (std::min(f.height(), f.width()) - d > smith_block_size) {
+    const dim_t rows = f.height() - d;
+    const dim_t cols = f.width() - d;
+
+    col_min.resize(cols);
+    smith_for(cols, rows * cols, [&](const dim_t k) {
+      static thread_local std::vector<val_t> scratch;
+      p_val_col(prime, f, d + k, d, scratch);
+      col_min[k] = *std::min_element(scratch.begin(), scratch.end());
+    });
+
+    // zero entries have maximal valuation.
+    const val_t v = *std::min_element(col_min.begin(), col_min.end());
+    if (v == std::numeric_limits<val_t>::max()) return;
+    if (v < 0)
+      throw std::logic_error(
+          "block_smith_reduce_p: matrix entry has negative valuation");
+
+    // the first columns with an entry of valuation v. Their entries are
+    // eliminated modulo p^(v + 1) to find pivots whose block is p^v times
+    // an invertible matrix; every column of the panel has at most one.
+    panel.clear();
+    for (dim_t k = 0; k < cols && panel.size() < smith_block_size; ++k) {
+      if (col_min[k] == v) panel.push_back(k);
+    }
+
+    Matrix<T> g(rows, panel.size());
+    for (dim_t i = 0; i < rows; ++i) {
+      for (dim_t c = 0; c < panel.size(); ++c) {
+        g(i, c) = f(d + i, d + panel[c]);
+      }
+    }
+
+    pivot_found.assign(rows, 0);
+    pivot_rows.clear();
+    pivot_cols.clear();
+    for (dim_t c = 0; c < panel.size(); ++c) {
+      dim_t i_pivot = rows;
+      for (dim_t i = 0; i < rows; ++i) {
+        if (!pivot_found[i] && g(i, c) && p_val_q(prime, g(i, c)) == v) {
+          i_pivot = i;
+          break;
+        }
+      }
+      if (i_pivot == rows) continue;
+
+      pivot_found[i_pivot] = 1;
+      pivot_rows.push_back(d + i_pivot);
+      pivot_cols.push_back(d + panel[c]);
+
+      MatrixVector<T> pivot_row = g.row(i_pivot);
+      smith_for(rows, rows * panel.size(), [&](const dim_t i) {
+        MatrixVector<T> row = g.row(i);
+        if (pivot_found[i] || !row[c]) return;
+
+        const T lambda = -row[c] / pivot_row[c];
+        for (dim_t c2 = c + 1; c2 < panel.size(); ++c2) {
+          mul_add(row[c2], lambda, pivot_row[c2]);
+        }
+      });
+    }
+
+    // moves the pivots to rows and columns d, ..., d + r - 1.
+    const dim_t r = pivot_rows.size();
+    for (dim_t k = 0; k < r; ++k) {
+      Y_change.swap(pivot_rows[k], d + k);
+      f.row_swap(pivot_rows[k], d + k);
+      X_change.swap(pivot_cols[k], d + k);
+      f.col_swap(pivot_cols[k], d + k);
+      for (dim_t k2 = k + 1; k2 < r; ++k2) {
+        if (pivot_rows[k2] == d + k) pivot_rows[k2] = pivot_rows[k];
+        if (pivot_cols[k2] == d + k) pivot_cols[k2] = pivot_cols[k];
+      }
+    }
+
+    // f is now [B C; D E] from (d, d) on, with B the r x r block of the
+    // pivots. B is reduced to p^v one pivot at a time, which changes the
+    // rows of C and the columns of D.
+    Matrix<T> b_block(r, r);
+    Matrix<T> c_block(r, cols - r);
+    Matrix<T> d_block(rows - r, r);
+    for (dim_t i = 0; i < r; ++i) {
+      for (dim_t j = 0; j < r; ++j) {
+        b_block(i, j) = f(d + i, d + j);
+      }
+      for (dim_t j = r; j < cols; ++j) {
+        c_block(i, j - r) = f(d + i, d + j);
+      }
+    }
+    for (dim_t i = r; i < rows; ++i) {
+      for (dim_t j = 0; j < r; ++j) {
+        d_block(i - r, j) = f(d + i, d + j);
+      }
+    }
+
+    BasisChange<T> B_X_change;
+    BasisChange<T> B_Y_change;
+    dense_smith_reduce_p<T, P>(p, b_block, B_X_change, B_Y_change);
+    MatrixRefList<T> c_block_ref = {c_block};
+    MatrixRefList<T> d_block_ref = {d_block};
+    B_Y_change.apply(c_block_ref, none);
+    B_X_change.apply(none, d_block_ref);
+    Y_change.append(B_Y_change, d);
+    X_change.append(B_X_change, d);
+
+    // with B = p^v, the rows of D and the columns of C are eliminated by
+    // the factors K = D / p^v and C / p^v, which leaves the Schur
+    // complement E - K C.
+    const u_val_t exp = static_cast<u_val_t>(v);
+    smith_for(rows - r, (rows - r) * r, [&](const dim_t i) {
+      for (dim_t j = 0; j < r; ++j) {
+        if (d_block(i, j))
+          d_block(i, j) = div_p_pow(prime, d_block(i, j), exp);
+      }
+    });
+    for (dim_t i = 0; i < rows - r; ++i) {
+      for (dim_t j = 0; j < r; ++j) {
+        if (d_block(i, j)) Y_change.add(d + r + i, d + j, d_block(i, j));
+      }
+    }
+    for (dim_t i = 0; i < r; ++i) {
+      for (dim_t j = 0; j < cols - r; ++j) {
+        if (c_block(i, j))
+          X_change.add(d + i, d + r + j,
+                       -div_p_pow(prime, c_block(i, j), exp));
+      }
+    }
+
+    const Matrix<T> update = d_block * c_block;
+    smith_for(rows, rows * cols, [&](const dim_t i) {
+      MatrixVector<T> row = f.row(d + i);
+      for (dim_t j = 0; j < cols; ++j) {
+        if (i < r && j < r)
+          row[d + j] = b_block(i, j);
+        else if (i < r || j < r)
+          row[d + j] = 0;
+        else
+          row[d + j] -= update(i - r, j - r);
+      }
+    });
+
+    d += r;
+  }
+
+  // the last rows or columns one pivot at a time.
+  Matrix<T> s(f.height() - d, f.width() - d);
+  for (dim_t i = 0; i < s.height(); ++i) {
+    for (dim_t j = 0; j < s.width(); ++j) {
+      s(i, j) = f(d + i, d + j);
+    }
+  }
+
+  BasisChange<T> s_X_change;
+  BasisChange<T> s_Y_change;
+  dense_smith_reduce_p<T, P>(p, s, s_X_change, s_Y_change);
+  Y_change.append(s_Y_change, d);
+  X_change.append(s_X_change, d);
+
+  for (dim_t i = 0; i < s.height(); ++i) {
+    for (dim_t j = 0; j < s.width(); ++j) {
+      f(d + i, d + j) = s(i, j);
+    }
+  }
+}
+
+template <typename T, mod_t P>
+void sparse_smith_reduce_p(const mod_t p, Matrix<T>& f,
+                           BasisChange<T>& X_change, BasisChange<T>& Y_change)
+{
+  const Prime<P> prime(p);
+
+  struct Entry
+  {
+    dim_t col;
+    T value;
+    val_t valuation;
+  };
+
+  // the remaining entries of every row of f, by increasing column, and the
+  // number of remaining entries in every column. Rows and columns keep their
+  // indices in f; the basis changes are recorded for the positions they are
+  // swapped to, row_pos and col_pos.
+  std::vector<std::vector<Entry>> rows(f.height());
+  std::vector<dim_t> col_count(f.width(), 0);
+  for (dim_t i = 0; i < f.height(); ++i) {
+    for (dim_t j = 0; j < f.width(); ++j) {
+      if (!f(i, j)) continue;
+      rows[i].push_back({j, f(i, j), p_val_q(prime, f(i, j))});
+      ++col_count[j];
+    }
+  }
+
+  std::vector<dim_t> row_pos(f.height());
+  std::vector<dim_t> row_at(f.height());
+  std::vector<dim_t> col_pos(f.width());
+  std::vector<dim_t> col_at(f.width());
+  for (dim_t i = 0; i < f.height(); ++i) {
+    row_pos[i] = row_at[i] = i;
+  }
+  for (dim_t j = 0; j < f.width(); ++j) {
+    col_pos[j] = col_at[j] = j;
+  }
+
+  auto find = [](const std::vector<Entry>& row, const dim_t j) {
+    return std::lower_bound(
+        row.begin(), row.end(), j,
+        [](const Entry& entry, const dim_t col) { return entry.col < col; });
+  };
+
+  T lambda;
+  T neg_lambda;
+  std::vector<val_t> diagonal;
+  std::vector<std::pair<dim_t, dim_t>> targets;
+  std::vector<Entry> merged;
+  for (dim_t d = 0; d < std::min(f.height(), f.width()); ++d) {
+    dim_t i_min = f.height();
+    dim_t j_min = 0;
+    val_t min_valuation = std::numeric_limits<val_t>::max();
+    dim_t min_cost = 0;
+
+    for (dim_t i = 0; i < f.height(); ++i) {
+      for (const Entry& entry : rows[i]) {
+        if (entry.valuation > min_valuation) continue;
+
+        const dim_t cost = (rows[i].size() - 1) * (col_count[entry.col] - 1);
+        if (entry.valuation < min_valuation || cost < min_cost) {
+          i_min = i;
+          j_min = entry.col;
+          min_valuation = entry.valuation;
+          min_cost = cost;
         }
       }
     }
 
-    if (!min_value) break;
+    if (i_min == f.height()) break;
     if (min_valuation < 0)
       throw std::logic_error(
-          "smith_reduce_p: matrix entry has negative valuation");
+          "sparse_smith_reduce_p: matrix entry has negative valuation");
 
-    for (dim_t i = diagonal_block_size; i < f.height(); ++i) {
+    std::vector<Entry>& pivot_row = rows[i_min];
+    const T min_value = find(pivot_row, j_min)->value;
+
+    // the rows with an entry in the pivot column, by position.
+    targets.clear();
+    for (dim_t i = 0; i < f.height(); ++i) {
       if (i == i_min) continue;
-      lambda = f(i, j_min) / min_value;
-      basis_vectors_add(to_Y, from_Y, i, i_min, lambda);
+      auto it = find(rows[i], j_min);
+      if (it != rows[i].end() && it->col == j_min)
+        targets.emplace_back(row_pos[i], i);
     }
+    std::sort(targets.begin(), targets.end());
 
-    for (dim_t j = diagonal_block_size; j < f.width(); ++j) {
-      if (j == j_min) continue;
-      lambda = -f(i_min, j) / min_value;
-      basis_vectors_add(to_X, from_X, j_min, j, lambda);
+    for (const std::pair<dim_t, dim_t>& target : targets) {
+      std::vector<Entry>& row = rows[target.second];
+      lambda = find(row, j_min)->value / min_value;
+      neg_lambda = -lambda;
+      Y_change.add(target.first, row_pos[i_min], lambda);
+
+      // row -= lambda * pivot_row, which cancels the entry in column j_min.
+      merged.clear();
+      auto it = row.begin();
+      for (const Entry& entry : pivot_row) {
+        for (; it != row.end() && it->col < entry.col; ++it) {
+          merged.push_back(std::move(*it));
+        }
+
+        if (entry.col == j_min) {
+          ++it;
+          --col_count[j_min];
+        } else if (it != row.end() && it->col == entry.col) {
+          mul_add(it->value, neg_lambda, entry.value);
+          if (!it->value) {
+            --col_count[entry.col];
+          } else {
+            it->valuation = p_val_q(prime, it->value);
+            merged.push_back(std::move(*it));
+          }
+          ++it;
+        } else {
+          // in Z/p^N, the product can vanish although neither factor does.
+          T value = neg_lambda * entry.value;
+          if (!value) continue;
+          const val_t valuation = p_val_q(prime, value);
+          merged.push_back({entry.col, std::move(value), valuation});
+          ++col_count[entry.col];
+        }
+      }
+      for (; it != row.end(); ++it) {
+        merged.push_back(std::move(*it));
+      }
+      row.swap(merged);
     }
 
-    basis_vectors_swap(to_Y, from_Y, i_min, diagonal_block_size);
-    basis_vectors_swap(to_X, from_X, j_min, diagonal_block_size);
+    // the pivot column is now zero outside the pivot, so the column
+    // operations only change the pivot row, which is done.
+    targets.clear();
+    for (dim_t k = 0; k < pivot_row.size(); ++k) {
+      --col_count[pivot_row[k].col];
+      if (pivot_row[k].col != j_min)
+        targets.emplace_back(col_pos[pivot_row[k].col], k);
+    }
+    std::sort(targets.begin(), targets.end());
+
+    for (const std::pair<dim_t, dim_t>& target : targets) {
+      lambda = -pivot_row[target.second].value / min_value;
+      X_change.add(col_pos[j_min], target.first, lambda);
+    }
+    pivot_row.clear();
+
+    using std::swap;
+    const dim_t i_d = row_at[d];
+    Y_change.swap(row_pos[i_min], d);
+    swap(row_at[row_pos[i_min]], row_at[d]);
+    swap(row_pos[i_min], row_pos[i_d]);
+
+    const dim_t j_d = col_at[d];
+    X_change.swap(col_pos[j_min], d);
+    swap(col_at[col_pos[j_min]], col_at[d]);
+    swap(col_pos[j_min], col_pos[j_d]);
+
+    lambda = p_pow<T>(prime, static_cast<u_val_t>(min_valuation)) / min_value;
+    X_change.mul(d, lambda);
+    diagonal.push_back(min_valuation);
+  }
+
+  for (dim_t i = 0; i < f.height(); ++i) {
+    for (dim_t j = 0; j < f.width(); ++j) {
+      f(i, j) = 0;
+    }
+  }
+  for (dim_t d = 0; d < diagonal.size(); ++d) {
+    f(d, d) = p_pow<T>(prime, static_cast<u_val_t>(diagonal[d]));
+  }
+}
 
-    lambda = p_pow_z(p, static_cast<u_val_t>(min_valuation)) / min_value;
-    basis_vectors_mul(to_X, from_X, diagonal_block_size, lambda);
+template <typename T, mod_t P>
+std::vector<val_t> smith_valuations_p(const mod_t p, Matrix<T> f)
+{
+  const Prime<P> prime(p);
+
+  // only the entries below and to the right of the pivots are kept up to
+  // date: the column operations of smith_reduce_p only change the row of the
+  // pivot, and its scaling only the pivot itself.
+  ValuationShadow<T, P> shadow(prime, f);
+  std::vector<val_t> diagonal;
+  for (dim_t d = 0; d < std::min(f.height(), f.width()); ++d) {
+    dim_t i_min = 0;
+    dim_t j_min = 0;
+    val_t min_valuation;
+    shadow.pivot(d, i_min, j_min, min_valuation);
+
+    if (min_valuation == std::numeric_limits<val_t>::max()) break;
+    if (min_valuation < 0)
+      throw std::logic_error(
+          "smith_valuations_p: matrix entry has negative valuation");
+
+    f.row_swap(i_min, d);
+    f.col_swap(j_min, d);
+    shadow.swap(d, i_min, j_min);
+    diagonal.push_back(min_valuation);
+
+    MatrixVector<T> pivot_row = f.row(d);
+    const dim_t rows = f.height() - d - 1;
+    smith_for(rows, rows * f.width(), [&](const dim_t k) {
+      MatrixVector<T> row = f.row(d + 1 + k);
+      if (!row[d]) return;
+
+      const T lambda = -row[d] / pivot_row[d];
+      for (dim_t j = d + 1; j < f.width(); ++j) {
+        mul_add(row[j], lambda, pivot_row[j]);
+      }
+      shadow.update(f, d + 1 + k, d + 1);
+    });
   }
 
-  from_X.pop_back();
-  to_Y.pop_back();
+  return diagonal;
 }
@@ -0,0 +1,134 @@
+#include "snapshot.h"
+
+#include <stdexcept>
+#include <vector>
+
+static void read_bytes(std::istream& stream, unsigned char* bytes,
+                       const std::size_t count)
+{
+  stream.read(reinterpret_cast<char*>(bytes),
+              static_cast<std::streamsize>(count));
+  if (static_cast<std::size_t>(stream.gcount()) != count) {
+    throw std::logic_error("read_bytes: Unexpected end of snapshot.");
+  }
+}
+
+void write_uint(std::ostream& stream, const std::uint64_t value)
+{
+  unsigned char bytes[8];
+  for (int i = 0; i < 8; ++i) {
+    bytes[i] = static_cast<unsigned char>(value >> (8 * i));
+  }
+  stream.write(reinterpret_cast<const char*>(bytes), 8);
+}
+
+std::uint64_t read_uint(std::istream& stream)
+{
+  unsigned char bytes[8];
+  read_bytes(stream, bytes, 8);
+
+  std::uint64_t value = 0;
+  for (int i = 0; i < 8; ++i) {
+    value |= static_cast<std::uint64_t>(bytes[i]) << (8 * i);
+  }
+  return value;
+}
+
+void write_int(std::ostream& stream, const std::int64_t value)
+{
+  write_uint(stream, static_cast<std::uint64_t>(value));
+}
+
+std::int64_t read_int(std::istream& stream)
+{
+  return static_cast<std::int64_t>(read_uint(stream));
+}
+
+void write_mpz(std::ostream& stream, const mpz_class& value)
+{
+  // the number of bytes of the magnitude, times two, plus one if negative.
+  std::size_t count = (mpz_sizeinbase(value.get_mpz_t(), 2) + 7) / 8;
+  std::vector<unsigned char> bytes(count);
+  if (sgn(value) != 0) {
+    mpz_export(bytes.data(), &count, -1, 1, 0, 0, value.get_mpz_t());
+  } else {
+    count = 0;
+  }
+
+  write_uint(stream, 2 * count + (sgn(value) < 0 ? 1 : 0));
+  stream.write(reinterpret_cast<const char*>(bytes.data()),
+               static_cast<std::streamsize>(count));
+}
+
+void read_mpz(std::istream& stream, mpz_class& value)
+{
+  const std::uint64_t header = read_uint(stream);
+  const std::size_t count = static_cast<std::size_t>(header / 2);
+
+  std::vector<unsigned char> bytes(count);
+  read_bytes(stream, bytes.data(), count);
+
+  mpz_import(value.get_mpz_t(), count, -1, 1, 0, 0, bytes.data());
+  if (header % 2 == 1) value = -value;
+}
+
+void write_mpq(std::ostream& stream, const mpq_class& value)
+{
+  write_mpz(stream, value.get_num());
+  write_mpz(stream, value.get_den());
+}
+
+void read_mpq(std::istream& stream, mpq_class& value)
+{
+  read_mpz(stream, value.get_num());
+  read_mpz(stream, value.get_den());
+  if (sgn(value.get_den()) <= 0) {
+    throw std::logic_error("read_mpq: Denominator is not positive.");
+  }
+}
+
+void write_matrix(std::ostream& stream, const MatrixQ& matrix)
+{
+  write_uint(stream, matrix.height());
+  write_uint(stream, matrix.width());
+  for (dim_t i = 0; i < matrix.height(); ++i) {
+    for (dim_t j = 0; j < matrix.width(); ++j) {
+      write_mpq(stream, matrix(i, j));
+    }
+  }
+}
+
+MatrixQ read_matrix(std::istream& stream)
+{
+  const dim_t height = read_uint(stream);
+  const dim_t width = read_uint(stream);
+
+  MatrixQ matrix(height, width);
+  for (dim_t i = 0; i < height; ++i) {
+    for (dim_t j = 0; j < width; ++j) {
+      read_mpq(stream, matrix(i, j));
+    }
+  }
+  return matrix;
+}
+
+void write_group(std::ostream& stream, const AbelianGroup& group)
+{
+  write_uint(stream, group.free_rank());
+  write_uint(stream, group.tor_rank());
+  for (dim_t i = 0; i < group.tor_rank(); ++i) {
+    write_uint(stream, group(i));
+  }
+}
+
+AbelianGroup read_group(std::istream& stream)
+{
+  const dim_t free_rank = read_uint(stream);
+  const dim_t tor_rank = read_uint(stream);
+
+  AbelianGroup group(free_rank, tor_rank);
+  for (dim_t i = 0; i < tor_rank; ++i) {
+    group(i) = read_uint(stream);
+  }
+  return group;
+}
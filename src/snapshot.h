@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+#include <gmpxx.h>
+
+#include "abelian_group.h"
+#include "matrix.h"
+#include "types.h"
+
+// The building blocks of the binary session snapshots. Integers are written
+// as 8 bytes, least significant first, and rationals as numerator and
+// denominator, each as its sign and magnitude followed by the magnitude in
+// bytes, least significant first. Reading past the end of the stream
+// throws.
+
+// the version of the snapshot format, written at the start of every
+// snapshot. Bump it whenever the layout of anything written changes.
+const std::uint64_t SNAPSHOT_VERSION = 1;
+
+void write_uint(std::ostream& stream, const std::uint64_t value);
+std::uint64_t read_uint(std::istream& stream);
+
+void write_int(std::ostream& stream, const std::int64_t value);
+std::int64_t read_int(std::istream& stream);
+
+void write_mpz(std::ostream& stream, const mpz_class& value);
+void read_mpz(std::istream& stream, mpz_class& value);
+
+void write_mpq(std::ostream& stream, const mpq_class& value);
+void read_mpq(std::istream& stream, mpq_class& value);
+
+void write_matrix(std::ostream& stream, const MatrixQ& matrix);
+MatrixQ read_matrix(std::istream& stream);
+
+void write_group(std::ostream& stream, const AbelianGroup& group);
+AbelianGroup read_group(std::istream& stream);
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+
+#include <gmpxx.h>
+
+#include "matrix.h"
+#include "types.h"
+
+// A matrix in compressed sparse row form: for every row, the columns and
+// values of its nonzero entries, by increasing column. Reading an entry
+// searches its row, and products with dense matrices only visit the nonzero
+// entries.
+template <typename T>
+class SparseMatrix;
+
+template <typename T>
+struct MatrixEntry<T, SparseMatrix>
+{
+  using type = const T&;
+};
+
+template <typename T>
+class SparseMatrix : public MatrixExpression<T, SparseMatrix>
+{
+ public:
+  SparseMatrix();
+  SparseMatrix(const dim_t height, const dim_t width);
+  explicit SparseMatrix(const Matrix<T>& f);
+
+  static SparseMatrix<T> identity(const dim_t n);
+
+  // the block diagonal matrix with the given number of copies of f.
+  static SparseMatrix<T> block_diagonal(const SparseMatrix<T>& f,
+                                        const dim_t copies);
+
+  inline dim_t height() const
+  {
+    return height_;
+  }
+
+  inline dim_t width() const
+  {
+    return width_;
+  }
+
+  inline dim_t nonzeros() const
+  {
+    return values_.size();
+  }
+
+  const T& operator()(const dim_t i, const dim_t j) const;
+
+  // the nonzero entries of row i are those at the positions k with
+  // row_begin(i) <= k < row_end(i), in column column(k) with value value(k).
+  inline dim_t row_begin(const dim_t i) const
+  {
+    return row_offsets_[i];
+  }
+
+  inline dim_t row_end(const dim_t i) const
+  {
+    return row_offsets_[i + 1];
+  }
+
+  inline dim_t column(const dim_t k) const
+  {
+    return columns_[k];
+  }
+
+  inline const T& value(const dim_t k) const
+  {
+    return values_[k];
+  }
+
+  Matrix<T> dense() const;
+
+  template <typename S>
+  friend Matrix<S> operator*(const SparseMatrix<S>& s, const Matrix<S>& f);
+  template <typename S>
+  friend Matrix<S> operator*(const Matrix<S>& f, const SparseMatrix<S>& s);
+
+ private:
+  dim_t height_;
+  dim_t width_;
+  // the nonzero entries of row i are at the positions
+  // row_offsets_[i], ..., row_offsets_[i + 1] - 1 of columns_ and values_.
+  std::vector<dim_t> row_offsets_;
+  std::vector<dim_t> columns_;
+  std::vector<T> values_;
+  T zero_;
+};
+
+template <typename T>
+Matrix<T> operator*(const SparseMatrix<T>& s, const Matrix<T>& f);
+template <typename T>
+Matrix<T> operator*(const Matrix<T>& f, const SparseMatrix<T>& s);
+
+using SparseMatrixQ = SparseMatrix<mpq_class>;
+
+#include "sparse_matrix_impl.h"
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <string>
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix() : SparseMatrix(0, 0)
+{
+}
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(const dim_t height, const dim_t width)
+    : height_(height), width_(width), row_offsets_(height + 1, 0), zero_(0)
+{
+}
+
+template <typename T>
+SparseMatrix<T>::SparseMatrix(const Matrix<T>& f)
+    : height_(f.height()), width_(f.width()), zero_(0)
+{
+  row_offsets_.reserve(height_ + 1);
+  row_offsets_.push_back(0);
+
+  for (dim_t i = 0; i < height_; ++i) {
+    for (dim_t j = 0; j < width_; ++j) {
+      const T& value = f(i, j);
+      if (!value) continue;
+      columns_.push_back(j);
+      values_.push_back(value);
+    }
+    row_offsets_.push_back(values_.size());
+  }
+}
+
+template <typename T>
+SparseMatrix<T> SparseMatrix<T>::identity(const dim_t n)
+{
+  SparseMatrix<T> result(n, n);
+  result.columns_.reserve(n);
+  result.values_.reserve(n);
+
+  for (dim_t i = 0; i < n; ++i) {
+    result.columns_.push_back(i);
+    result.values_.push_back(T(1));
+    result.row_offsets_[i + 1] = i + 1;
+  }
+
+  return result;
+}
+
+template <typename T>
+SparseMatrix<T> SparseMatrix<T>::block_diagonal(const SparseMatrix<T>& f,
+                                                const dim_t copies)
+{
+  SparseMatrix<T> result(f.height_ * copies, f.width_ * copies);
+  result.columns_.reserve(f.nonzeros() * copies);
+  result.values_.reserve(f.nonzeros() * copies);
+
+  dim_t i = 0;
+  for (dim_t copy = 0; copy < copies; ++copy) {
+    for (dim_t row = 0; row < f.height_; ++row, ++i) {
+      for (dim_t k = f.row_offsets_[row]; k < f.row_offsets_[row + 1]; ++k) {
+        result.columns_.push_back(copy * f.width_ + f.columns_[k]);
+        result.values_.push_back(f.values_[k]);
+      }
+      result.row_offsets_[i + 1] = result.values_.size();
+    }
+  }
+
+  return result;
+}
+
+template <typename T>
+const T& SparseMatrix<T>::operator()(const dim_t i, const dim_t j) const
+{
+  auto first = columns_.begin();
+  auto begin = first + static_cast<std::ptrdiff_t>(row_offsets_[i]);
+  auto end = first + static_cast<std::ptrdiff_t>(row_offsets_[i + 1]);
+  auto it = std::lower_bound(begin, end, j);
+
+  if (it == end || *it != j) return zero_;
+  return values_[static_cast<dim_t>(it - first)];
+}
+
+template <typename T>
+Matrix<T> SparseMatrix<T>::dense() const
+{
+  Matrix<T> result(height_, width_);
+  for (dim_t i = 0; i < height_; ++i) {
+    for (dim_t k = row_offsets_[i]; k < row_offsets_[i + 1]; ++k) {
+      result(i, columns_[k]) = values_[k];
+    }
+  }
+  return result;
+}
+
+template <typename T>
+Matrix<T> operator*(const SparseMatrix<T>& s, const Matrix<T>& f)
+{
+  if (s.width() != f.height())
+    throw std::logic_error("SparseMatrix<T>::operator*: Dimension mismatch" +
+                           std::to_string(s.width()) + " != " +
+                           std::to_string(f.height()));
+
+  Matrix<T> sf(s.height(), f.width());
+  for (dim_t i = 0; i < s.height(); ++i) {
+    for (dim_t k = s.row_offsets_[i]; k < s.row_offsets_[i + 1]; ++k) {
+      const T& value = s.values_[k];
+      const dim_t row = s.columns_[k];
+
+      for (dim_t j = 0; j < f.width(); ++j) {
+        mul_add(sf(i, j), value, f(row, j));
+      }
+    }
+  }
+
+  return sf;
+}
+
+template <typename T>
+Matrix<T> operator*(const Matrix<T>& f, const SparseMatrix<T>& s)
+{
+  if (f.width() != s.height())
+    throw std::logic_error("SparseMatrix<T>::operator*: Dimension mismatch" +
+                           std::to_string(f.width()) + " != " +
+                           std::to_string(s.height()));
+
+  Matrix<T> fs(f.height(), s.width());
+  for (dim_t i = 0; i < f.height(); ++i) {
+    for (dim_t row = 0; row < s.height(); ++row) {
+      const T& value = f(i, row);
+      if (!value) continue;
+
+      for (dim_t k = s.row_offsets_[row]; k < s.row_offsets_[row + 1]; ++k) {
+        mul_add(fs(i, s.columns_[k]), value, s.values_[k]);
+      }
+    }
+  }
+
+  return fs;
+}
@@ -1,7 +1,12 @@
 #include "spectral_sequence.h"
 
+#include <algorithm>
+#include <mutex>
 #include <sstream>
 #include <tuple>
+#include <utility>
+
+#include "snapshot.h"
 
 TrigradedIndex::TrigradedIndex(const deg_t p, const deg_t q, const deg_t s)
     : p_(p), q_(q), s_(s)
@@ -114,145 +119,237 @@ void GroupSequence::inc()
   ++current_;
 }
 
-SpectralSequence::SpectralSequence(const mod_t prime) : prime_(prime)
+DifferentialRef::DifferentialRef(const dim_t height, const dim_t width)
+    : matrix_(nullptr), height_(height), width_(width)
+{
+}
+
+DifferentialRef::DifferentialRef(const MatrixQ& matrix)
+    : matrix_(&matrix), height_(matrix.height()), width_(matrix.width())
+{
+}
+
+dim_t DifferentialRef::height() const
+{
+  return height_;
+}
+
+dim_t DifferentialRef::width() const
+{
+  return width_;
+}
+
+bool DifferentialRef::is_implicit_zero() const
+{
+  return !matrix_;
+}
+
+const MatrixQ& DifferentialRef::matrix() const
+{
+  if (matrix_) return *matrix_;
+  if (zero_.height() != height_ || zero_.width() != width_) {
+    zero_ = MatrixQ(height_, width_);
+  }
+  return zero_;
+}
+
+std::ostream& operator<<(std::ostream& stream, const DifferentialRef& diff)
+{
+  return stream << diff.matrix();
+}
+
+// the results of the getters for indices outside of the bounds.
+static const AbelianGroup& zero_group()
+{
+  static const AbelianGroup zero(0, 0);
+  return zero;
+}
+
+static const MatrixQ& empty_matrix()
+{
+  static const MatrixQ empty(0, 0);
+  return empty;
+}
+
+void GroupSequence::save(std::ostream& stream) const
+{
+  write_uint(stream, done_ ? 1 : 0);
+  write_uint(stream, current_);
+  write_uint(stream, entries_.size());
+  for (const auto& entry : entries_) {
+    write_uint(stream, entry.first);
+    write_group(stream, entry.second.first);
+    write_matrix(stream, entry.second.second);
+  }
+}
+
+GroupSequence GroupSequence::load(std::istream& stream)
+{
+  const bool done = read_uint(stream) != 0;
+  const dim_t current = read_uint(stream);
+  const dim_t count = read_uint(stream);
+  if (count == 0) {
+    throw std::logic_error("GroupSequence::load: Sequence has no entries.");
+  }
+
+  std::map<dim_t, std::pair<AbelianGroup, MatrixQ>> entries;
+  for (dim_t i = 0; i < count; ++i) {
+    const dim_t index = read_uint(stream);
+    AbelianGroup group = read_group(stream);
+    MatrixQ matrix = read_matrix(stream);
+    entries.emplace(index,
+                    std::make_pair(std::move(group), std::move(matrix)));
+  }
+
+  GroupSequence sequence(entries.begin()->first,
+                         entries.begin()->second.first);
+  sequence.done_ = done;
+  sequence.current_ = current;
+  sequence.entries_.swap(entries);
+  return sequence;
+}
+
+SpectralSequence::SpectralSequence(const mod_t prime)
+    : mutex_(new std::recursive_mutex()), prime_(prime)
 {
 }
 
 void SpectralSequence::set_diff_zero(TrigradedIndex pqs, dim_t r)
 {
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
   std::pair<deg_t, deg_t> bounds_ker = get_bounds(pqs.q());
   std::pair<deg_t, deg_t> bounds_coker =
       get_bounds(pqs.q() + static_cast<deg_t>(r) - 1);
 
   if (bounds_ker.first <= pqs.s() && bounds_ker.second >= pqs.s()) {
-    auto kers_it = kernels_.find(pqs);
-    if (kers_it == kernels_.end()) {
+    GroupSequence* kers = kernels_.find(pqs);
+    if (!kers) {
       std::stringstream str;
       str << "SpectralSequence::set_diff_zero: Kernel at " << pqs
           << " is not set.";
       throw std::logic_error(str.str());
     }
-    if (kers_it->second.get_current() != r) {
+    if (kers->get_current() != r) {
       throw std::logic_error(
           "SpectralSequence::set_diff_zero: Kernel is at wrong r.");
     }
-    kers_it->second.inc();
+    kers->inc();
   }
   if (bounds_coker.first <= pqs.s() + 1 && bounds_coker.second >= pqs.s() + 1) {
-    auto cokers_it = cokernels_.find(target(pqs, r));
-    if (cokers_it == cokernels_.end()) {
+    GroupSequence* cokers = cokernels_.find(target(pqs, r));
+    if (!cokers) {
       throw std::logic_error(
           "SpectralSequence::set_diff_zero: Cokernel is not set.");
     }
-    if (cokers_it->second.get_current() != r) {
+    if (cokers->get_current() != r) {
       throw std::logic_error(
           "SpectralSequence::set_diff_zero: Cokernel is at wrong r.");
     }
-    cokers_it->second.inc();
+    cokers->inc();
   }
 }
 
 void SpectralSequence::set_diff(TrigradedIndex pqs, dim_t r, MatrixQ matrix)
 {
-  std::pair<deg_t, deg_t> bounds_source = get_bounds(pqs.q());
-  std::pair<deg_t, deg_t> bounds_target =
-      get_bounds(pqs.q() + static_cast<deg_t>(r) - 1);
-
-  if (pqs.s() < bounds_source.first || pqs.s() > bounds_source.second) {
-    if (pqs.s() + 1 < bounds_target.first ||
-        pqs.s() + 1 > bounds_target.second) {
-      return;
-    } else {
-      auto cokers_it = cokernels_.find(target(pqs, r));
-      if (cokers_it == cokernels_.end()) {
-        std::stringstream msg;
-        msg << "SpectralSequence::set_diff: Cokernel is not set. (At pqs=(" << pqs.p()<<","<<pqs.q()
-                     <<","<<pqs.s()<<") and r="<<r << "\n";
-        throw std::logic_error(msg.str());
-      }
-      if (cokers_it->second.get_current() != r) {
-        throw std::logic_error(
-            "SpectralSequence::set_diff: Cokernel is at wrong r.");
+  GroupSequence* kers;
+  GroupSequence* cokers;
+  {
+    std::lock_guard<std::recursive_mutex> lock(*mutex_);
+    std::pair<deg_t, deg_t> bounds_source = get_bounds(pqs.q());
+    std::pair<deg_t, deg_t> bounds_target =
+        get_bounds(pqs.q() + static_cast<deg_t>(r) - 1);
+
+    if (pqs.s() < bounds_source.first || pqs.s() > bounds_source.second) {
+      if (pqs.s() + 1 < bounds_target.first ||
+          pqs.s() + 1 > bounds_target.second) {
+        return;
+      } else {
+        cokers = cokernels_.find(target(pqs, r));
+        if (!cokers) {
+          std::stringstream msg;
+          msg << "SpectralSequence::set_diff: Cokernel is not set. (At pqs=(" << pqs.p()<<","<<pqs.q()
+                       <<","<<pqs.s()<<") and r="<<r << "\n";
+          throw std::logic_error(msg.str());
+        }
+        if (cokers->get_current() != r) {
+          throw std::logic_error(
+              "SpectralSequence::set_diff: Cokernel is at wrong r.");
+        }
+        // could check whether matrix is 0.
+        cokers->inc();
+        return;
       }
-      // could check whether matrix is 0.
-      cokers_it->second.inc();
-      return;
     }
-  } else {
     if (pqs.s() + 1 < bounds_target.first ||
         pqs.s() + 1 > bounds_target.second) {
-      auto kers_it = kernels_.find(pqs);
-      if (kers_it == kernels_.end()) {
+      kers = kernels_.find(pqs);
+      if (!kers) {
         throw std::logic_error(
             "SpectralSequence::set_diff: Kernel is not set.");
       }
-      if (kers_it->second.get_current() != r) {
+      if (kers->get_current() != r) {
         throw std::logic_error(
             "SpectralSequence::set_diff: Kernel is at wrong r.");
       }
       // could check whether matrix is 0.
-      kers_it->second.inc();
+      kers->inc();
       return;
-    } else {
-      auto kers_it = kernels_.find(pqs);
-      if (kers_it == kernels_.end()) {
-        throw std::logic_error(
-            "SpectralSequence::set_diff: Kernel is not set.");
-      }
-      if (kers_it->second.get_current() != r) {
-        throw std::logic_error(
-            "SpectralSequence::set_diff: Kernel is at wrong r.");
-      }
-      auto cokers_it = cokernels_.find(target(pqs, r));
-      if (cokers_it == cokernels_.end()) {
-        std::stringstream msg;
-        msg << "SpectralSequence::set_diff: Cokernel is not set. (At pqs=(" << pqs.p()<<","<<pqs.q()
-        <<","<<pqs.s()<<") and r="<<r << "\n";
-        throw std::logic_error(msg.str());
-      }
-      if (cokers_it->second.get_current() != r) {
-        throw std::logic_error(
-            "SpectralSequence::set_diff: Cokernel is at wrong r.");
-      }
-      AbelianGroup X = kers_it->second.get_group(r);
-      AbelianGroup Y = cokers_it->second.get_group(r);
-      if (morphism_zero(prime_, matrix, Y)) {
-        kers_it->second.inc();
-        cokers_it->second.inc();
-        return;
-      }
+    }
 
-      MatrixQ inc_X = kers_it->second.get_matrix(r);
-      MatrixQ proj_Y = cokers_it->second.get_matrix(r);
+    kers = kernels_.find(pqs);
+    if (!kers) {
+      throw std::logic_error(
+          "SpectralSequence::set_diff: Kernel is not set.");
+    }
+    if (kers->get_current() != r) {
+      throw std::logic_error(
+          "SpectralSequence::set_diff: Kernel is at wrong r.");
+    }
+    cokers = cokernels_.find(target(pqs, r));
+    if (!cokers) {
+      std::stringstream msg;
+      msg << "SpectralSequence::set_diff: Cokernel is not set. (At pqs=(" << pqs.p()<<","<<pqs.q()
+      <<","<<pqs.s()<<") and r="<<r << "\n";
+      throw std::logic_error(msg.str());
+    }
+    if (cokers->get_current() != r) {
+      throw std::logic_error(
+          "SpectralSequence::set_diff: Cokernel is at wrong r.");
+    }
+  }
 
-      MatrixQList from_X, to_Y;
-      from_X.emplace_back(inc_X);
-      to_Y.emplace_back(proj_Y);
+  // the reduction runs without the lock. Only this call advances kers and
+  // cokers past r, and the entries up to r stay where they are.
+  const AbelianGroup& X = kers->get_group(r);
+  const AbelianGroup& Y = cokers->get_group(r);
+  if (morphism_zero(prime_, matrix, Y)) {
+    std::lock_guard<std::recursive_mutex> lock(*mutex_);
+    kers->inc();
+    cokers->inc();
+    return;
+  }
 
-      GroupWithMorphisms new_kernel =
-          compute_kernel(prime_, matrix, X, Y, MatrixQRefList(), ref(from_X));
-      GroupWithMorphisms new_cokernel =
-          compute_cokernel(prime_, matrix, Y, ref(to_Y), MatrixQRefList());
+  MatrixQList from_X, to_Y;
+  from_X.emplace_back(kers->get_matrix(r));
+  to_Y.emplace_back(cokers->get_matrix(r));
 
-      kers_it->second.append(r + 1, new_kernel.group, new_kernel.maps_from[0]);
-      cokers_it->second.append(r + 1, new_cokernel.group,
-                               new_cokernel.maps_to[0]);
+  KernelAndCokernel new_groups = compute_kernel_and_cokernel(
+      prime_, matrix, X, Y, MatrixQRefList(), ref(from_X), ref(to_Y),
+      MatrixQRefList());
+  const GroupWithMorphisms& new_kernel = new_groups.kernel;
+  const GroupWithMorphisms& new_cokernel = new_groups.cokernel;
 
-      auto diffmap_it = differentials_.find(pqs);
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
+  kers->append(r + 1, new_kernel.group, new_kernel.maps_from[0]);
+  cokers->append(r + 1, new_cokernel.group, new_cokernel.maps_to[0]);
 
-      if (diffmap_it == differentials_.end()) {
-        std::map<dim_t, MatrixQ> diffs_at_pqs;
-        diffs_at_pqs.insert(std::pair<dim_t, MatrixQ>(r, matrix));
-        differentials_.emplace(pqs, diffs_at_pqs);
-      } else {
-        diffmap_it->second.emplace(r, matrix);
-      }
-    }
-  }
+  differentials_.emplace(pqs, std::map<dim_t, MatrixQ>())
+      .emplace(r, matrix);
 }
 
 std::pair<deg_t, deg_t> SpectralSequence::get_bounds(deg_t q) const
 {
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
   auto bounds_it = bounds_.find(q);
   std::stringstream msg;
 
@@ -265,6 +362,7 @@ std::pair<deg_t, deg_t> SpectralSequence::get_bounds(deg_t q) const
 
 void SpectralSequence::set_bounds(deg_t q, deg_t min_s, deg_t max_s)
 {
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
   auto bounds_it = bounds_.find(q);
   if (bounds_it == bounds_.end()) {
     bounds_.emplace(q, std::make_pair(min_s, max_s));
@@ -273,62 +371,57 @@ void SpectralSequence::set_bounds(deg_t q, deg_t min_s, deg_t max_s)
   }
 }
 
-MatrixQ SpectralSequence::get_diff_from(TrigradedIndex pqs, dim_t r) const
+DifferentialRef SpectralSequence::get_diff_from(TrigradedIndex pqs,
+                                                dim_t r) const
 {
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
   TrigradedIndex pqs_target = target(pqs, r);
 
   if (pqs_target.p() < 0 || pqs_target.q() < 0) {
-    return MatrixQ(0, 0);
+    return DifferentialRef(0, 0);
   }
 
   std::pair<deg_t, deg_t> bounds = get_bounds(pqs.q());
   if (pqs.s() < bounds.first || pqs.s() > bounds.second) {
-    return MatrixQ(0, 0);
+    return DifferentialRef(0, 0);
   }
 
   std::pair<deg_t, deg_t> bounds_target = get_bounds(pqs_target.q());
   if (pqs_target.s() < bounds_target.first ||
       pqs_target.s() > bounds_target.second) {
-    return MatrixQ(0, 0);
+    return DifferentialRef(0, 0);
   }
 
-  auto kers_it = kernels_.find(pqs);
-  auto cokers_it = cokernels_.find(pqs_target);
-  if (kers_it == kernels_.end()) {
+  const GroupSequence* kers = kernels_.find(pqs);
+  const GroupSequence* cokers = cokernels_.find(pqs_target);
+  if (!kers) {
     throw std::logic_error(
         "SpectralSequence::get_diff_from: Domain is not set.");
   }
-  if (cokers_it == kernels_.end()) {
+  if (!cokers) {
     throw std::logic_error(
         "SpectralSequence::get_diff_from: Codomain is not set.");
   }
-  if (kers_it->second.get_current() <= r) {
+  if (kers->get_current() <= r) {
     throw std::logic_error(
         "SpectralSequence::get_diff_from: Differential isn't set yet.");
   }
-  if (cokers_it->second.get_current() <= r) {
+  if (cokers->get_current() <= r) {
     throw std::logic_error(
         "SpectralSequence::get_diff_from: Differential isn't set yet.");
   }
 
-  auto diffmap_it = differentials_.find(pqs);
-  if (diffmap_it == differentials_.end()) {
-    dim_t height = cokers_it->second.get_group(r).rank();
-    dim_t width = kers_it->second.get_group(r).rank();
-    MatrixQ result(height, width);
-    return result;
-  }
-  auto diff_it = diffmap_it->second.find(r);
-  if (diff_it == diffmap_it->second.end()) {
-    dim_t height = cokers_it->second.get_group(r).rank();
-    dim_t width = kers_it->second.get_group(r).rank();
-    MatrixQ result(height, width);
-    return result;
+  const std::map<dim_t, MatrixQ>* diffmap = differentials_.find(pqs);
+  if (diffmap) {
+    auto diff_it = diffmap->find(r);
+    if (diff_it != diffmap->end()) return DifferentialRef(diff_it->second);
   }
-  return diff_it->second;
+  return DifferentialRef(cokers->get_group(r).rank(),
+                         kers->get_group(r).rank());
 }
 
-MatrixQ SpectralSequence::get_diff_to(TrigradedIndex pqs, std::size_t r) const
+DifferentialRef SpectralSequence::get_diff_to(TrigradedIndex pqs,
+                                              std::size_t r) const
 {
   return get_diff_from(source(pqs, r), r);
 }
@@ -338,160 +431,261 @@ MatrixQ SpectralSequence::get_diff_to(TrigradedIndex pqs, std::size_t r) const
 // for example, get_e_ab(pqs, r, r) computes the E_r page at pqs.
 GroupWithMorphisms SpectralSequence::get_e_ab(TrigradedIndex pqs, dim_t a,
                                               dim_t b) const
+{
+  const EabKey key(pqs, std::max<dim_t>(a, 2), std::max<dim_t>(b, 2));
+  const MatrixQ* projection;
+  const MatrixQ* inclusion;
+  AbelianGroup K;
+  AbelianGroup C;
+  {
+    std::lock_guard<std::recursive_mutex> lock(*mutex_);
+    auto cache_it = e_ab_cache_.find(key);
+    if (cache_it != e_ab_cache_.end()) {
+      ++e_ab_cache_hits_;
+      return cache_it->second;
+    }
+    if (!get_e_ab_map(pqs, a, b, projection, inclusion, K, C)) {
+      return GroupWithMorphisms(0, 0);
+    }
+  }
+
+  GroupWithMorphisms e_ab =
+      compute_image(prime_, (*projection) * (*inclusion), K, C);
+
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
+  ++e_ab_cache_misses_;
+  return e_ab_cache_.emplace(key, std::move(e_ab)).first->second;
+}
+
+AbelianGroup SpectralSequence::get_e_ab_group(TrigradedIndex pqs, dim_t a,
+                                              dim_t b) const
+{
+  const EabKey key(pqs, std::max<dim_t>(a, 2), std::max<dim_t>(b, 2));
+  const MatrixQ* projection;
+  const MatrixQ* inclusion;
+  AbelianGroup K;
+  AbelianGroup C;
+  {
+    std::lock_guard<std::recursive_mutex> lock(*mutex_);
+    auto cache_it = e_ab_cache_.find(key);
+    if (cache_it != e_ab_cache_.end()) {
+      ++e_ab_cache_hits_;
+      return cache_it->second.group;
+    }
+    auto group_it = e_ab_group_cache_.find(key);
+    if (group_it != e_ab_group_cache_.end()) {
+      ++e_ab_cache_hits_;
+      return group_it->second;
+    }
+    if (!get_e_ab_map(pqs, a, b, projection, inclusion, K, C)) {
+      return AbelianGroup(0, 0);
+    }
+  }
+
+  AbelianGroup e_ab =
+      compute_image_group(prime_, (*projection) * (*inclusion), C);
+
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
+  ++e_ab_cache_misses_;
+  return e_ab_group_cache_.emplace(key, std::move(e_ab)).first->second;
+}
+
+std::size_t SpectralSequence::get_e_ab_cache_hits() const
+{
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
+  return e_ab_cache_hits_;
+}
+
+std::size_t SpectralSequence::get_e_ab_cache_misses() const
+{
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
+  return e_ab_cache_misses_;
+}
+
+bool SpectralSequence::get_e_ab_map(TrigradedIndex pqs, dim_t a, dim_t b,
+                                    const MatrixQ*& projection,
+                                    const MatrixQ*& inclusion,
+                                    AbelianGroup& K, AbelianGroup& C) const
 {
   if (a < 2) a = 2;
   if (b < 2) b = 2;
   std::pair<deg_t, deg_t> bounds = get_bounds(pqs.q());
   if (pqs.s() < bounds.first || pqs.s() > bounds.second) {
-    return GroupWithMorphisms(0, 0);
+    return false;
   }
-  auto kers_it = kernels_.find(pqs);
-  auto cokers_it = cokernels_.find(pqs);
-  if (kers_it == kernels_.end()) {
+  const GroupSequence* kers = kernels_.find(pqs);
+  const GroupSequence* cokers = cokernels_.find(pqs);
+  if (!kers) {
     throw std::logic_error("SpectralSequence::get_e_ab: Kernel is not set.");
   }
-  if (cokers_it == cokernels_.end()) {
+  if (!cokers) {
     throw std::logic_error("SpectralSequence::get_e_ab: Cokernel is not set.");
   }
-  if (kers_it->second.get_current() < a) {
+  if (kers->get_current() < a) {
     throw std::logic_error("SpectralSequence::get_e_ab: Kernel is at wrong r.");
   }
-  if (cokers_it->second.get_current() < b) {
+  if (cokers->get_current() < b) {
     throw std::logic_error(
         "SpectralSequence::get_e_ab: Cokernel is at wrong r.");
   }
 
-  AbelianGroup K = kers_it->second.get_group(a);
-  AbelianGroup C = cokers_it->second.get_group(b);
-
-  MatrixQ map =
-      (cokers_it->second.get_matrix(b)) * (kers_it->second.get_matrix(a));
-
-  GroupWithMorphisms I = compute_image(prime_, map, K, C);
-  return I;
+  K = kers->get_group(a);
+  C = cokers->get_group(b);
+  projection = &cokers->get_matrix(b);
+  inclusion = &kers->get_matrix(a);
+  return true;
 }
 
-AbelianGroup SpectralSequence::get_e_2(TrigradedIndex pqs) const
+const AbelianGroup& SpectralSequence::get_e_2(TrigradedIndex pqs) const
 {
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
   std::pair<deg_t, deg_t> bounds = get_bounds(pqs.q());
   if (pqs.s() < bounds.first || pqs.s() > bounds.second) {
-    return AbelianGroup(0, 0);
+    return zero_group();
   }
-  auto kers = kernels_.find(pqs);
-  if (kers == kernels_.end()) {
+  const GroupSequence* kers = kernels_.find(pqs);
+  if (!kers) {
     throw std::logic_error("SpectralSequence::get_e_2: Group is not set.");
   }
 
-  return kers->second.get_group(2);
+  return kers->get_group(2);
 }
 
-AbelianGroup SpectralSequence::get_kernel(TrigradedIndex pqs, dim_t r) const
+const AbelianGroup& SpectralSequence::get_kernel(TrigradedIndex pqs,
+                                                 dim_t r) const
 {
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
   std::pair<deg_t, deg_t> bounds = get_bounds(pqs.q());
   if (pqs.s() < bounds.first || pqs.s() > bounds.second) {
-    return AbelianGroup(0, 0);
+    return zero_group();
   }
-  auto kers_it = kernels_.find(pqs);
-  if (kers_it == kernels_.end()) {
+  const GroupSequence* kers = kernels_.find(pqs);
+  if (!kers) {
     std::stringstream str;
     str << "SpectralSequence::get_kernel: Group at " << pqs << " is not set.";
     throw std::logic_error(str.str());
   }
-  if (kers_it->second.get_current() < r) {
+  if (kers->get_current() < r) {
     throw std::logic_error(
         "SpectralSequence::get_kernel: Kernel is at wrong r.");
   }
-  return kers_it->second.get_group(r);
+  return kers->get_group(r);
 }
 
-AbelianGroup SpectralSequence::get_cokernel(TrigradedIndex pqs, dim_t r) const
+const AbelianGroup& SpectralSequence::get_cokernel(TrigradedIndex pqs,
+                                                   dim_t r) const
 {
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
   std::pair<deg_t, deg_t> bounds = get_bounds(pqs.q());
   if (pqs.s() < bounds.first || pqs.s() > bounds.second) {
-    return AbelianGroup(0, 0);
+    return zero_group();
   }
-  auto cokers_it = cokernels_.find(pqs);
-  if (cokers_it == cokernels_.end()) {
+  const GroupSequence* cokers = cokernels_.find(pqs);
+  if (!cokers) {
     std::stringstream str;
     str << "SpectralSequence::get_cokernel: Group at " << pqs << " is not set.";
     throw std::logic_error(str.str());
   }
-  if (cokers_it->second.get_current() < r) {
+  if (cokers->get_current() < r) {
     std::stringstream str;
     str << "SpectralSequence::get_cokernel: Cokernel is at wrong r. (p,q,s)="<<pqs<<", r="<<r<<", but is at r="
-        << cokers_it->second.get_current() << "\n";
+        << cokers->get_current() << "\n";
     throw std::logic_error(str.str());
   }
-  return cokers_it->second.get_group(r);
+  return cokers->get_group(r);
 }
 
 bool SpectralSequence::ker_is_at_least(TrigradedIndex pqs, dim_t r) {
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
   std::pair<deg_t, deg_t> bounds = get_bounds(pqs.q());
   if (pqs.s() < bounds.first || pqs.s() > bounds.second){
     return true;
   }
-  auto kers_it = kernels_.find(pqs);
-  if(kers_it==kernels_.end()){
+  const GroupSequence* kers = kernels_.find(pqs);
+  if(!kers){
     return false;
   }
-  return (kers_it->second.get_current() >= r);
+  return (kers->get_current() >= r);
 }
 
 bool SpectralSequence::coker_is_at_least(TrigradedIndex pqs, dim_t r) {
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
   std::pair<deg_t, deg_t> bounds = get_bounds(pqs.q());
   if (pqs.s() < bounds.first || pqs.s() > bounds.second){
     return true;
   }
-  auto cokers_it = cokernels_.find(pqs);
-  if(cokers_it==cokernels_.end()){
+  const GroupSequence* cokers = cokernels_.find(pqs);
+  if(!cokers){
     return false;
   }
-  return (cokers_it->second.get_current() >= r);
+  return (cokers->get_current() >= r);
 }
 
-MatrixQ SpectralSequence::get_inclusion(TrigradedIndex pqs, dim_t r) const
+bool SpectralSequence::reached(const SequenceState& state) const
 {
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
+  const TrigradedIndex& pqs = state.pqs;
+  if (pqs.p() < 0 || pqs.q() < 0) return true;
+
+  auto bounds_it = bounds_.find(pqs.q());
+  if (bounds_it == bounds_.end()) return false;
+  if (pqs.s() < bounds_it->second.first || pqs.s() > bounds_it->second.second) {
+    return true;
+  }
+
+  const GroupSequence* sequence =
+      state.kernel ? kernels_.find(pqs) : cokernels_.find(pqs);
+  return sequence && sequence->get_current() >= state.r;
+}
+
+const MatrixQ& SpectralSequence::get_inclusion(TrigradedIndex pqs,
+                                               dim_t r) const
+{
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
   std::pair<deg_t, deg_t> bounds = get_bounds(pqs.q());
   if (pqs.s() < bounds.first || pqs.s() > bounds.second) {
-    return MatrixQ(0, 0);
+    return empty_matrix();
   }
-  auto kers_it = kernels_.find(pqs);
-  if (kers_it == kernels_.end()) {
+  const GroupSequence* kers = kernels_.find(pqs);
+  if (!kers) {
     throw std::logic_error(
         "SpectralSequence::get_inclusion: Group is not set.");
   }
-  if (kers_it->second.get_current() < r) {
+  if (kers->get_current() < r) {
     throw std::logic_error(
         "SpectralSequence::get_inclusion: Kernel is at wrong r.");
   }
-  return kers_it->second.get_matrix(r);
+  return kers->get_matrix(r);
 }
 
-MatrixQ SpectralSequence::get_projection(TrigradedIndex pqs, dim_t r) const
+const MatrixQ& SpectralSequence::get_projection(TrigradedIndex pqs,
+                                                dim_t r) const
 {
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
   std::pair<deg_t, deg_t> bounds = get_bounds(pqs.q());
   if (pqs.s() < bounds.first || pqs.s() > bounds.second) {
-    return MatrixQ(0, 0);
+    return empty_matrix();
   }
-  auto cokers_it = cokernels_.find(pqs);
-  if (cokers_it == cokernels_.end()) {
+  const GroupSequence* cokers = cokernels_.find(pqs);
+  if (!cokers) {
     throw std::logic_error(
         "SpectralSequence::get_projection: Group is not set.");
   }
-  if (cokers_it->second.get_current() < r) {
+  if (cokers->get_current() < r) {
     throw std::logic_error(
         "SpectralSequence::get_projection: Cokernel is at wrong r.");
   }
-  return cokers_it->second.get_matrix(r);
+  return cokers->get_matrix(r);
 }
 
 void SpectralSequence::set_e2(TrigradedIndex pqs, AbelianGroup grp)
 {
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
   std::pair<deg_t, deg_t> bounds = get_bounds(pqs.q());
   if (pqs.s() < bounds.first || pqs.s() > bounds.second) {
     throw std::logic_error("SpectralSequence::set_e2: Group is already set.");
   }
-  if (kernels_.find(pqs) != kernels_.end()) {
+  if (kernels_.find(pqs)) {
     throw std::logic_error("SpectralSequence::set_e2: Group is already set.");
   }
   GroupSequence ker2(2, grp);
@@ -500,6 +694,99 @@ void SpectralSequence::set_e2(TrigradedIndex pqs, AbelianGroup grp)
   cokernels_.emplace(pqs, ker2);
 }
 
+static void write_index(std::ostream& stream, const TrigradedIndex& pqs)
+{
+  write_int(stream, pqs.p());
+  write_int(stream, pqs.q());
+  write_int(stream, pqs.s());
+}
+
+static TrigradedIndex read_index(std::istream& stream)
+{
+  const deg_t p = read_int(stream);
+  const deg_t q = read_int(stream);
+  const deg_t s = read_int(stream);
+  return TrigradedIndex(p, q, s);
+}
+
+static void write_sequences(std::ostream& stream,
+                            const TrigradedGrid<GroupSequence>& sequences)
+{
+  write_uint(stream, sequences.size());
+  sequences.for_each(
+      [&stream](const TrigradedIndex& pqs, const GroupSequence& sequence) {
+        write_index(stream, pqs);
+        sequence.save(stream);
+      });
+}
+
+static void read_sequences(std::istream& stream,
+                           TrigradedGrid<GroupSequence>& sequences)
+{
+  const dim_t count = read_uint(stream);
+  for (dim_t i = 0; i < count; ++i) {
+    const TrigradedIndex pqs = read_index(stream);
+    sequences.emplace(pqs, GroupSequence::load(stream));
+  }
+}
+
+void SpectralSequence::save(std::ostream& stream) const
+{
+  std::lock_guard<std::recursive_mutex> lock(*mutex_);
+  write_uint(stream, prime_);
+
+  write_uint(stream, bounds_.size());
+  for (const auto& bounds : bounds_) {
+    write_int(stream, bounds.first);
+    write_int(stream, bounds.second.first);
+    write_int(stream, bounds.second.second);
+  }
+
+  write_sequences(stream, kernels_);
+  write_sequences(stream, cokernels_);
+
+  write_uint(stream, differentials_.size());
+  differentials_.for_each([&stream](const TrigradedIndex& pqs,
+                                    const std::map<dim_t, MatrixQ>& diffs) {
+    write_index(stream, pqs);
+    write_uint(stream, diffs.size());
+    for (const auto& diff : diffs) {
+      write_uint(stream, diff.first);
+      write_matrix(stream, diff.second);
+    }
+  });
+}
+
+SpectralSequence SpectralSequence::load(std::istream& stream)
+{
+  SpectralSequence sequence(static_cast<mod_t>(read_uint(stream)));
+
+  const dim_t bounds_count = read_uint(stream);
+  for (dim_t i = 0; i < bounds_count; ++i) {
+    const deg_t q = read_int(stream);
+    const deg_t min_s = read_int(stream);
+    const deg_t max_s = read_int(stream);
+    sequence.set_bounds(q, min_s, max_s);
+  }
+
+  read_sequences(stream, sequence.kernels_);
+  read_sequences(stream, sequence.cokernels_);
+
+  const dim_t diffs_count = read_uint(stream);
+  for (dim_t i = 0; i < diffs_count; ++i) {
+    const TrigradedIndex pqs = read_index(stream);
+    std::map<dim_t, MatrixQ>& diffs =
+        sequence.differentials_.emplace(pqs, std::map<dim_t, MatrixQ>());
+    const dim_t count = read_uint(stream);
+    for (dim_t j = 0; j < count; ++j) {
+      const dim_t r = read_uint(stream);
+      diffs.emplace(r, read_matrix(stream));
+    }
+  }
+
+  return sequence;
+}
+
 mod_t SpectralSequence::get_prime() const
 {
   return prime_;
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <cstddef>
+#include <deque>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
 #include <vector>
 #include "abelian_group.h"
 #include "morphisms.h"
@@ -45,6 +50,46 @@ TrigradedIndex operator-(const TrigradedIndex& a, const TrigradedIndex& b);
 TrigradedIndex source(const TrigradedIndex& pqs, dim_t r);
 TrigradedIndex target(const TrigradedIndex& pqs, dim_t r);
 
+// A table of values indexed by (p, q, s) with p, q, s >= 0, stored densely
+// along the diagonals p + q = n that Session::step sweeps. Every diagonal is
+// one contiguous array of slots with p major and s minor, and grows with
+// the largest n and s that have been set, so lookups are two array reads.
+// The values themselves are kept in a deque, which keeps them in place when
+// later entries are added.
+template <typename V>
+class TrigradedGrid
+{
+ public:
+  // the value at pqs, or nullptr if it is not set.
+  V* find(const TrigradedIndex& pqs);
+  const V* find(const TrigradedIndex& pqs) const;
+
+  // sets the value at pqs unless it is set already, and returns the value
+  // at pqs.
+  V& emplace(const TrigradedIndex& pqs, const V& value);
+
+  dim_t size() const;
+
+  // calls f(pqs, value) for all values, in the order of TrigradedIndex.
+  template <typename F>
+  void for_each(F f) const;
+
+ private:
+  struct Diagonal
+  {
+    // slot p * s_extent + s holds one plus the position of the value at
+    // (p, n - p, s) in values_, or 0 if it is not set.
+    dim_t s_extent = 0;
+    std::vector<dim_t> slots;
+  };
+
+  // the slot of pqs, or nullptr if it lies outside of the grid.
+  const dim_t* slot(const TrigradedIndex& pqs) const;
+
+  std::vector<Diagonal> diagonals_;
+  std::deque<V> values_;
+};
+
 class GroupSequence
 {
  public:
@@ -56,6 +101,10 @@ class GroupSequence
   dim_t get_current() const;
   void inc();
 
+  // the binary snapshot of the sequence, see snapshot.h.
+  void save(std::ostream& stream) const;
+  static GroupSequence load(std::istream& stream);
+
  private:
   bool done_;
   std::map<dim_t, std::pair<AbelianGroup, MatrixQ>> entries_;
@@ -70,33 +119,113 @@ class GroupSequence
   // set explicitly.
 };
 
+// The state that the kernel (or cokernel) sequence at pqs has reached page
+// r: the differentials d_2, ..., d_{r - 1} leaving (or entering) pqs are
+// set, which for r = 2 means that E_2 at pqs is.
+struct SequenceState
+{
+  TrigradedIndex pqs;
+  bool kernel;
+  dim_t r;
+};
+
+// A differential returned by SpectralSequence::get_diff_from: either the
+// stored matrix, which is referenced rather than copied, or the zero matrix
+// of a given size for a differential that was never set, which is only
+// allocated if matrix() is asked for it. A stored matrix stays valid as
+// long as the spectral sequence does.
+class DifferentialRef
+{
+ public:
+  DifferentialRef(const dim_t height, const dim_t width);
+  explicit DifferentialRef(const MatrixQ& matrix);
+
+  dim_t height() const;
+  dim_t width() const;
+  // whether this is an implicit zero; a stored matrix may still be zero.
+  bool is_implicit_zero() const;
+  const MatrixQ& matrix() const;
+
+ private:
+  const MatrixQ* matrix_;
+  dim_t height_;
+  dim_t width_;
+  mutable MatrixQ zero_;
+};
+
+std::ostream& operator<<(std::ostream& stream, const DifferentialRef& diff);
+
 class SpectralSequence
 {
  public:
   SpectralSequence(mod_t prime);
   void set_diff_zero(TrigradedIndex pqs, dim_t r);
   void set_diff(TrigradedIndex pqs, dim_t r, MatrixQ matrix);
-  MatrixQ get_diff_from(TrigradedIndex pqs, dim_t r) const;
-  MatrixQ get_diff_to(TrigradedIndex pqs, dim_t r) const;
+  DifferentialRef get_diff_from(TrigradedIndex pqs, dim_t r) const;
+  DifferentialRef get_diff_to(TrigradedIndex pqs, dim_t r) const;
   GroupWithMorphisms get_e_ab(TrigradedIndex pqs, dim_t a, dim_t b) const;
-  AbelianGroup get_e_2(TrigradedIndex pqs) const;
-  AbelianGroup get_kernel(TrigradedIndex pqs, dim_t r) const;
-  AbelianGroup get_cokernel(TrigradedIndex pqs, dim_t r) const;
-  MatrixQ get_inclusion(TrigradedIndex pqs, dim_t r) const;
-  MatrixQ get_projection(TrigradedIndex pqs, dim_t r) const;
+  // only the group of get_e_ab.
+  AbelianGroup get_e_ab_group(TrigradedIndex pqs, dim_t a, dim_t b) const;
+  // the groups and maps below are references into the spectral sequence,
+  // which stay valid as long as it does.
+  const AbelianGroup& get_e_2(TrigradedIndex pqs) const;
+  const AbelianGroup& get_kernel(TrigradedIndex pqs, dim_t r) const;
+  const AbelianGroup& get_cokernel(TrigradedIndex pqs, dim_t r) const;
+  const MatrixQ& get_inclusion(TrigradedIndex pqs, dim_t r) const;
+  const MatrixQ& get_projection(TrigradedIndex pqs, dim_t r) const;
   void set_e2(TrigradedIndex pqs, AbelianGroup grp);
   mod_t get_prime() const;
   std::pair<deg_t, deg_t> get_bounds(deg_t q) const;
   void set_bounds(deg_t q, deg_t min_s, deg_t max_s);
   bool ker_is_at_least(TrigradedIndex pqs, dim_t r);
   bool coker_is_at_least(TrigradedIndex pqs, dim_t r);
+  // whether state holds. States outside of the bounds always hold, and
+  // states in a q without bounds never do.
+  bool reached(const SequenceState& state) const;
+
+  // the number of get_e_ab and get_e_ab_group calls answered from the cache,
+  // and the number that had to compute it.
+  std::size_t get_e_ab_cache_hits() const;
+  std::size_t get_e_ab_cache_misses() const;
+
+  // the binary snapshot of the groups, maps, differentials and bounds, see
+  // snapshot.h. The E_ab cache is not saved.
+  void save(std::ostream& stream) const;
+  static SpectralSequence load(std::istream& stream);
 
 private:
-  std::map<TrigradedIndex, GroupSequence> kernels_;
-  std::map<TrigradedIndex, GroupSequence> cokernels_;
-  std::map<TrigradedIndex, std::map<dim_t, MatrixQ>> differentials_;
+  // guards the grids, the bounds and the E_ab caches, so that tasks on
+  // several threads can share the spectral sequence. The reductions and
+  // image computations run outside of it. Held by pointer to keep the
+  // spectral sequence movable.
+  std::unique_ptr<std::recursive_mutex> mutex_;
+
+  // the a-th kernel K and the b-th cokernel C at pqs, and the projection
+  // to C and the inclusion of K, whose product has image E_ab. Returns
+  // false if pqs is out of bounds. Expects the caller to hold mutex_.
+  bool get_e_ab_map(TrigradedIndex pqs, dim_t a, dim_t b,
+                    const MatrixQ*& projection, const MatrixQ*& inclusion,
+                    AbelianGroup& K, AbelianGroup& C) const;
+
+  // the results of get_e_ab and get_e_ab_group by (pqs, a, b), with a and b
+  // at least 2. get_e_ab_map only reads kernels and cokernels up to the
+  // current index of their sequence, and those never change once set, so
+  // the entries never need to be invalidated. Nothing is evicted either:
+  // the caches grow with every E_ab asked for over the lifetime of the
+  // spectral sequence.
+  using EabKey = std::tuple<TrigradedIndex, dim_t, dim_t>;
+  mutable std::map<EabKey, GroupWithMorphisms> e_ab_cache_;
+  mutable std::map<EabKey, AbelianGroup> e_ab_group_cache_;
+  mutable std::size_t e_ab_cache_hits_ = 0;
+  mutable std::size_t e_ab_cache_misses_ = 0;
+
+  TrigradedGrid<GroupSequence> kernels_;
+  TrigradedGrid<GroupSequence> cokernels_;
+  TrigradedGrid<std::map<dim_t, MatrixQ>> differentials_;
   std::map<deg_t, std::pair<deg_t, deg_t>> bounds_;
   // const TrigradedIndex diff_offset_; oops, depends on r. Do we want a
   // function object for that?
   mod_t prime_;
 };
+
+#include "spectral_sequence_impl.h"
@@ -0,0 +1,90 @@
+#include <stdexcept>
+
+template <typename V>
+const dim_t* TrigradedGrid<V>::slot(const TrigradedIndex& pqs) const
+{
+  if (pqs.p() < 0 || pqs.q() < 0 || pqs.s() < 0) return nullptr;
+
+  const dim_t n = static_cast<dim_t>(pqs.p() + pqs.q());
+  if (n >= diagonals_.size()) return nullptr;
+
+  const Diagonal& diagonal = diagonals_[n];
+  const dim_t s = static_cast<dim_t>(pqs.s());
+  if (s >= diagonal.s_extent) return nullptr;
+
+  return &diagonal.slots[static_cast<dim_t>(pqs.p()) * diagonal.s_extent + s];
+}
+
+template <typename V>
+V* TrigradedGrid<V>::find(const TrigradedIndex& pqs)
+{
+  const dim_t* position = slot(pqs);
+  if (!position || *position == 0) return nullptr;
+  return &values_[*position - 1];
+}
+
+template <typename V>
+const V* TrigradedGrid<V>::find(const TrigradedIndex& pqs) const
+{
+  const dim_t* position = slot(pqs);
+  if (!position || *position == 0) return nullptr;
+  return &values_[*position - 1];
+}
+
+template <typename V>
+V& TrigradedGrid<V>::emplace(const TrigradedIndex& pqs, const V& value)
+{
+  if (pqs.p() < 0 || pqs.q() < 0 || pqs.s() < 0) {
+    throw std::logic_error(
+        "TrigradedGrid::emplace: Index has a negative entry.");
+  }
+
+  const dim_t n = static_cast<dim_t>(pqs.p() + pqs.q());
+  if (n >= diagonals_.size()) diagonals_.resize(n + 1);
+
+  Diagonal& diagonal = diagonals_[n];
+  const dim_t s = static_cast<dim_t>(pqs.s());
+  if (s >= diagonal.s_extent) {
+    // widen every row of the diagonal to s + 1 slots.
+    std::vector<dim_t> slots((n + 1) * (s + 1), 0);
+    for (dim_t p = 0; p <= n; ++p) {
+      for (dim_t t = 0; t < diagonal.s_extent; ++t) {
+        slots[p * (s + 1) + t] = diagonal.slots[p * diagonal.s_extent + t];
+      }
+    }
+    diagonal.slots.swap(slots);
+    diagonal.s_extent = s + 1;
+  }
+
+  dim_t& position =
+      diagonal.slots[static_cast<dim_t>(pqs.p()) * diagonal.s_extent + s];
+  if (position == 0) {
+    values_.push_back(value);
+    position = values_.size();
+  }
+  return values_[position - 1];
+}
+
+template <typename V>
+dim_t TrigradedGrid<V>::size() const
+{
+  return values_.size();
+}
+
+template <typename V>
+template <typename F>
+void TrigradedGrid<V>::for_each(F f) const
+{
+  for (dim_t n = 0; n < diagonals_.size(); ++n) {
+    const Diagonal& diagonal = diagonals_[n];
+    for (dim_t p = 0; p <= n; ++p) {
+      for (dim_t s = 0; s < diagonal.s_extent; ++s) {
+        const dim_t position = diagonal.slots[p * diagonal.s_extent + s];
+        if (position == 0) continue;
+        f(TrigradedIndex(static_cast<deg_t>(p), static_cast<deg_t>(n - p),
+                         static_cast<deg_t>(s)),
+          values_[position - 1]);
+      }
+    }
+  }
+}
@@ -1,6 +1,8 @@
 #include <sstream>
+#include "kronecker_matrix.h"
 #include "morphisms.h"
 #include "p_local.h"
+#include "snapshot.h"
 #include "spectral_sequence.h"
 #include "task.h"
 
@@ -8,6 +10,30 @@ Task::Task(Session& session) : session_(session)
 {
 }
 
+std::unique_ptr<Task> Task::load(Session& session, std::istream& stream)
+{
+  const std::uint64_t kind = read_uint(stream);
+  if (kind == static_cast<std::uint64_t>(Kind::group)) {
+    const deg_t p = read_int(stream);
+    const deg_t q = read_int(stream);
+    return std::unique_ptr<Task>(new GroupTask(session, p, q));
+  }
+  if (kind == static_cast<std::uint64_t>(Kind::differential)) {
+    const deg_t p = read_int(stream);
+    const deg_t q = read_int(stream);
+    const deg_t s = read_int(stream);
+    const dim_t r = read_uint(stream);
+    return std::unique_ptr<Task>(
+        new DifferentialTask(session, TrigradedIndex(p, q, s), r));
+  }
+  if (kind == static_cast<std::uint64_t>(Kind::extension)) {
+    const deg_t q = read_int(stream);
+    const deg_t s = read_int(stream);
+    return std::unique_ptr<Task>(new ExtensionTask(session, q, s));
+  }
+  throw std::logic_error("Task::load: Unknown kind of task.");
+}
+
 GroupTask::GroupTask(Session& session, const deg_t p, const deg_t q)
     : Task(session), p_(p), q_(q)
 {
@@ -47,6 +73,36 @@ void GroupTask::display_overview() {
   throw std::logic_error("GroupTask::display_overview(): should not be called.");
 }
 
+std::vector<SequenceState> GroupTask::reads() const
+{
+  std::pair<deg_t, deg_t> bounds = session_.get_sequence().get_bounds(q_);
+
+  std::vector<SequenceState> states;
+  for (deg_t s = bounds.first; s <= bounds.second; s++) {
+    states.push_back({TrigradedIndex(0, q_, s), true, 2});
+  }
+  return states;
+}
+
+std::vector<SequenceState> GroupTask::writes() const
+{
+  std::pair<deg_t, deg_t> bounds = session_.get_sequence().get_bounds(q_);
+
+  std::vector<SequenceState> states;
+  for (deg_t s = bounds.first; s <= bounds.second; s++) {
+    states.push_back({TrigradedIndex(p_, q_, s), true, 2});
+    states.push_back({TrigradedIndex(p_, q_, s), false, 2});
+  }
+  return states;
+}
+
+void GroupTask::save(std::ostream& stream) const
+{
+  write_uint(stream, static_cast<std::uint64_t>(Kind::group));
+  write_int(stream, p_);
+  write_int(stream, q_);
+}
+
 ExtensionTask::ExtensionTask(Session& session, deg_t q, deg_t s)
     : Task(session), q_(q), s_(s)
 {
@@ -70,14 +126,16 @@ bool ExtensionTask::autosolve()
   }
   // now, for n=q_+1, s=1, we have to compute e_ab mod the v_n.
   if (s_ == 1) {
-    AbelianGroup iterated_kernel =
+    const AbelianGroup& iterated_kernel =
         sequence.get_kernel(TrigradedIndex(q_ + 1, 0, 0), q_+1);
-    MatrixQ inclusion =
+    const MatrixQ& inclusion =
         sequence.get_inclusion(TrigradedIndex(q_ + 1, 0, 0), q_+1);
 
-    MatrixQ v_i_map = session_.get_v_inclusion(q_ + 1);
+    // lift_from_free reduces its right hand side in place, so the sparse
+    // v_i_map is made dense here, once per task.
+    const SparseMatrixQ& v_i_map = session_.get_v_inclusion(q_ + 1);
     MatrixQ matrix = lift_from_free(
-        sequence.get_prime(), v_i_map, inclusion,
+        sequence.get_prime(), v_i_map.dense(), inclusion,
         iterated_kernel);  // compute lift of v_i_map along inclusion.
     MatrixQ id = MatrixQ::identity(matrix.height());
     GroupWithMorphisms coker = compute_cokernel(
@@ -186,6 +244,49 @@ void ExtensionTask::display_overview() {
   std::cout << "ExtensionTask for s="<<s_ <<", q="<<q_<<"\n";
 }
 
+std::vector<SequenceState> ExtensionTask::reads() const
+{
+  const TrigradedIndex pqs(0, q_, s_);
+  // q_ is never negative.
+  const dim_t q = static_cast<dim_t>(q_);
+
+  // the E_ab terms that the differentials into (0, q, s) come from.
+  std::vector<SequenceState> states;
+  for (dim_t n = 2; n <= q; n++) {
+    states.push_back({source(pqs, n), true, n});
+    states.push_back({source(pqs, n), false, q - n + 3});
+  }
+  states.push_back({source(pqs, q + 1), true, q + 1});
+  if (s_ == 1) {
+    states.push_back({TrigradedIndex(q_ + 1, 0, 0), true, q + 1});
+  }
+  return states;
+}
+
+std::vector<SequenceState> ExtensionTask::writes() const
+{
+  const TrigradedIndex pqs(0, q_, s_);
+  // q_ is never negative.
+  const dim_t q = static_cast<dim_t>(q_);
+
+  // E_2 at (0, q, s), and every differential into it.
+  std::vector<SequenceState> states;
+  states.push_back({pqs, true, 2});
+  states.push_back({pqs, false, 2});
+  for (dim_t r = 2; r <= q + 1; r++) {
+    states.push_back({source(pqs, r), true, r + 1});
+    states.push_back({pqs, false, r + 1});
+  }
+  return states;
+}
+
+void ExtensionTask::save(std::ostream& stream) const
+{
+  write_uint(stream, static_cast<std::uint64_t>(Kind::extension));
+  write_int(stream, q_);
+  write_int(stream, s_);
+}
+
 DifferentialTask::DifferentialTask(Session& session, TrigradedIndex index,
                                    dim_t r)
     : Task(session), index_(index), r_(r)
@@ -223,77 +324,80 @@ bool DifferentialTask::autosolve()
     return true;
   }
 
-  AbelianGroup ker_right_domain = sequence.get_kernel(index_, r_);
-  AbelianGroup coker_right_codomain =
+  const AbelianGroup& ker_right_domain = sequence.get_kernel(index_, r_);
+  const AbelianGroup& coker_right_codomain =
       sequence.get_cokernel(target(index_, r_), r_);
 
-  GroupWithMorphisms e_right_domain = sequence.get_e_ab(index_, r_, index_.q()+2);
-  if (e_right_domain.group.rank() == 0 || coker_right_codomain.rank() == 0) {
+  AbelianGroup e_right_domain =
+      sequence.get_e_ab_group(index_, r_, index_.q() + 2);
+  if (e_right_domain.rank() == 0 || coker_right_codomain.rank() == 0) {
     sequence.set_diff_zero(index_, r_);
     return true;
   }
 
   deg_t r_s = static_cast<deg_t>(r_);
-  AbelianGroup e2_left_codomain =
+  const AbelianGroup& e2_left_codomain =
       sequence.get_e_2(TrigradedIndex(0, index_.q() + r_s - 1, index_.s() + 1));
   //std::cout << "e2_left_codomain:\n";
   //e2_left_codomain.print(std::cout, sequence.get_prime());
   //std::cout << "\n";
-  AbelianGroup er_left_codomain = sequence.get_cokernel(
+  const AbelianGroup& er_left_codomain = sequence.get_cokernel(
       TrigradedIndex(0, index_.q() + r_s - 1, index_.s() + 1), r_);
   //std::cout << "er_left_codomain:\n";
   //er_left_codomain.print(std::cout, sequence.get_prime());
   //std::cout << "\n";
-  MatrixQ projection_left_img = sequence.get_projection(
+  const MatrixQ& projection_left_img = sequence.get_projection(
       TrigradedIndex(0, index_.q() + r_s - 1, index_.s() + 1), r_);
   //std::cout << "MatrixQ projection_left_img:\n" << projection_left_img << "\n";
 
 
-  MatrixQ diff_left =
+  DifferentialRef diff_left =
       sequence.get_diff_from(TrigradedIndex(r_s, index_.q(), index_.s()), r_);
   //std::cout << "MatrixQ diff_left:\n" << diff_left << "\n";
   //"lift" the differential from (r,q,s) -> (0,q-r+1,s+1) over
   // projection_left_img
   //(actually just a free presentation)
-  MatrixQ lift = lift_from_free(sequence.get_prime(), diff_left,
-                                projection_left_img, er_left_codomain);
+  // a differential that was never set lifts to zero.
+  MatrixQ lift =
+      diff_left.is_implicit_zero()
+          ? MatrixQ(projection_left_img.width(), diff_left.width())
+          : lift_from_free(sequence.get_prime(), diff_left.matrix(),
+                           projection_left_img, er_left_codomain);
   //std::cout << "lift:\n" << lift << "\n";
 
-  AbelianGroup e2_0_q_s =
+  const AbelianGroup& e2_0_q_s =
       sequence.get_e_2(TrigradedIndex(0, index_.q(), index_.s()));
 
   dim_t mon_rank = session_.get_monomial_rank(index_.p() - r_s);
   MatrixQ result_lift(mon_rank * e2_left_codomain.rank(), ker_right_domain.rank());
 
-  MatrixQ inclusion_right_domain = sequence.get_inclusion(index_, r_);
+  const MatrixQ& inclusion_right_domain = sequence.get_inclusion(index_, r_);
   //std::cout << "inclusion_right_domain:\n" << inclusion_right_domain << "\n";
-  AbelianGroup ker_left_domain =
+  const AbelianGroup& ker_left_domain =
       sequence.get_kernel(TrigradedIndex(r_s, index_.q(), index_.s()), r_);
-  MatrixQ inclusion_left_domain =
+  const MatrixQ& inclusion_left_domain =
       sequence.get_inclusion(TrigradedIndex(r_s, index_.q(), index_.s()), r_);
   //std::cout << "inclusion_left_domain:\n" << inclusion_left_domain << "\n";
+  MatrixQList r_I_right;
+  r_I_right.reserve(mon_rank);
   for (dim_t i = 0; i < mon_rank; i++) {
     // r_ is both the page number and the p of the transgression
-    MatrixQ r_I =
+    const SparseMatrixQ& r_I =
         session_.get_r_operations(index_.p(), static_cast<deg_t>(r_), i);
-    //std::cout << "r_I:\n" << r_I << "\n";
+    //std::cout << "r_I:\n" << r_I.dense() << "\n";
     // obtain the tensor product A\otimes r_I, where A is the group e2_0_q_s.
-    MatrixQ r_I_q(r_I.height() * e2_0_q_s.rank(),
-                  r_I.width() * e2_0_q_s.rank());
-    for (dim_t diag = 0; diag < e2_0_q_s.rank(); diag++) {
-      for (dim_t height = 0; height < r_I.height(); height++) {
-        for (dim_t width = 0; width < r_I.width(); width++) {
-          r_I_q(diag * r_I.height() + height, diag * r_I.width() + width) =
-              r_I(height, width);
-        }
-      }
-    }
-    //std::cout << "r_I_q:\n" << r_I_q << "\n";
-    // lift r_I_q * inclusion_right_domain against
-    // inclusion_left_domain (okay because this is injective).
-    MatrixQ r_I_ker =
-        lift_from_free(sequence.get_prime(), r_I_q * inclusion_right_domain,
-                       inclusion_left_domain, ker_left_domain);
+    KroneckerMatrixQ r_I_q(SparseMatrixQ::identity(e2_0_q_s.rank()), r_I);
+    r_I_right.push_back(r_I_q * inclusion_right_domain);
+  }
+  // lift every r_I_q * inclusion_right_domain against
+  // inclusion_left_domain (okay because this is injective), with a single
+  // reduction of inclusion_left_domain.
+  MatrixQList r_I_kers =
+      PreparedLift(sequence.get_prime(), inclusion_left_domain,
+                   ker_left_domain)
+          .lift(r_I_right);
+  for (dim_t i = 0; i < mon_rank; i++) {
+    const MatrixQ& r_I_ker = r_I_kers[i];
     //std::cout << "r_I_ker:\n" << r_I_ker << "\n";
     MatrixQ lift_r_I = lift * r_I_ker;
     //std::cout << "lift_r_I:\n" << lift_r_I << "\n";
@@ -304,7 +408,7 @@ bool DifferentialTask::autosolve()
     }
   }
 
-  MatrixQ projection_right_img = sequence.get_projection(
+  const MatrixQ& projection_right_img = sequence.get_projection(
       TrigradedIndex(index_.p() - r_s, index_.q() + r_s - 1, index_.s() + 1),
       r_);
 
@@ -318,16 +422,10 @@ bool DifferentialTask::autosolve()
       compute_kernel(sequence.get_prime(), projection_left_img, e2_left_codomain,
                      er_left_codomain, MatrixQRefList(), ref(from_X));
   MatrixQ from_K = *ker_proj_morphisms.maps_from.begin();
-  MatrixQ from_K_tensor(from_K.height() * mon_rank, from_K.width() * mon_rank);
-  for (dim_t i = 0; i < from_K.height(); i++) {
-    for (dim_t j = 0; j < from_K.width(); j++) {
-      for (dim_t d = 0; d < mon_rank; d++) {
-        from_K_tensor(i * mon_rank + d, j * mon_rank + d) = from_K(i, j);
-      }
-    }
-  }
+  KroneckerMatrixQ from_K_tensor(SparseMatrixQ(from_K),
+                                 SparseMatrixQ::identity(mon_rank));
 
-  AbelianGroup coker_right_img = sequence.get_cokernel(
+  const AbelianGroup& coker_right_img = sequence.get_cokernel(
       TrigradedIndex(index_.p() - r_s, index_.q() + r_s - 1, index_.s() + 1),
       r_);
   MatrixQ indet_map = projection_right_img * from_K_tensor;
@@ -392,3 +490,37 @@ void DifferentialTask::display_overview() {
   << index_.s()
   << ")\n";
 }
+
+void DifferentialTask::save(std::ostream& stream) const
+{
+  write_uint(stream, static_cast<std::uint64_t>(Kind::differential));
+  write_int(stream, index_.p());
+  write_int(stream, index_.q());
+  write_int(stream, index_.s());
+  write_uint(stream, r_);
+}
+
+std::vector<SequenceState> DifferentialTask::reads() const
+{
+  std::vector<SequenceState> states;
+  states.push_back({index_, true, r_});
+  states.push_back({target(index_, r_), false, r_});
+  if (index_.p() % 2 == 1 || (index_.p() - static_cast<deg_t>(r_)) % 2 == 1) {
+    return states;
+  }
+
+  // E_{r, q + 2} at index, and the differential d_r from (r, q, s) to
+  // (0, q + r - 1, s + 1) together with E_2 at both ends.
+  const deg_t r_s = static_cast<deg_t>(r_);
+  const TrigradedIndex left(r_s, index_.q(), index_.s());
+  states.push_back({index_, false, static_cast<dim_t>(index_.q() + 2)});
+  states.push_back({left, true, r_ + 1});
+  states.push_back({target(left, r_), false, r_ + 1});
+  states.push_back({TrigradedIndex(0, index_.q(), index_.s()), true, 2});
+  return states;
+}
+
+std::vector<SequenceState> DifferentialTask::writes() const
+{
+  return {{index_, true, r_ + 1}, {target(index_, r_), false, r_ + 1}};
+}
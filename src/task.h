@@ -1,6 +1,10 @@
 #pragma once
 
+#include <istream>
 #include <map>
+#include <memory>
+#include <ostream>
+#include <vector>
 
 #include "session.h"
 #include "spectral_sequence.h"
@@ -18,7 +22,25 @@ class Task
   virtual bool usersolve() = 0;
   virtual void display_overview() = 0;
   virtual void display_detail() = 0;
+
+  // the states of the spectral sequence that autosolve reads, and the ones
+  // that solving the task brings the spectral sequence to. The
+  // TaskScheduler runs a task once everything it reads holds.
+  virtual std::vector<SequenceState> reads() const = 0;
+  virtual std::vector<SequenceState> writes() const = 0;
+
+  // the binary snapshot of the task, see snapshot.h: its kind and where it
+  // is. Anything autosolve computed is computed again after loading.
+  virtual void save(std::ostream& stream) const = 0;
+  static std::unique_ptr<Task> load(Session& session, std::istream& stream);
 protected:
+  enum class Kind
+  {
+    group,
+    differential,
+    extension
+  };
+
   Session& session_;
 };
 
@@ -32,6 +54,9 @@ class GroupTask : public Task
   bool usersolve() override;
   void display_overview() override;
   void display_detail() override;
+  std::vector<SequenceState> reads() const override;
+  std::vector<SequenceState> writes() const override;
+  void save(std::ostream& stream) const override;
 private:
   deg_t p_;
   deg_t q_;
@@ -52,6 +77,9 @@ class DifferentialTask : public Task
   bool usersolve() override;
   void display_overview() override;
   void display_detail() override;
+  std::vector<SequenceState> reads() const override;
+  std::vector<SequenceState> writes() const override;
+  void save(std::ostream& stream) const override;
 private:
   TrigradedIndex index_;
   dim_t r_;
@@ -84,6 +112,9 @@ class ExtensionTask : public Task
   bool usersolve() override;
   void display_overview() override;
   void display_detail() override;
+  std::vector<SequenceState> reads() const override;
+  std::vector<SequenceState> writes() const override;
+  void save(std::ostream& stream) const override;
  private:
   deg_t q_;
   deg_t s_;
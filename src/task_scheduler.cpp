@@ -0,0 +1,125 @@
+#include "task_scheduler.h"
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+#include "task.h"
+#include "thread_pool.h"
+
+using StateKey = std::tuple<TrigradedIndex, bool, dim_t>;
+
+static StateKey state_key(const SequenceState& state)
+{
+  return std::make_tuple(state.pqs, state.kernel, state.r);
+}
+
+static std::string describe(const SequenceState& state)
+{
+  std::stringstream str;
+  str << (state.kernel ? "kernel" : "cokernel") << " at " << state.pqs
+      << " on page " << state.r;
+  return str.str();
+}
+
+TaskScheduler::TaskScheduler()
+{
+}
+
+TaskScheduler::~TaskScheduler()
+{
+}
+
+void TaskScheduler::add(std::unique_ptr<Task> task)
+{
+  tasks_.push_back(std::move(task));
+}
+
+void TaskScheduler::clear()
+{
+  tasks_.clear();
+}
+
+std::list<std::unique_ptr<Task>> TaskScheduler::run(
+    const SpectralSequence& sequence)
+{
+  const dim_t count = tasks_.size();
+
+  // the task writing every state that does not hold yet.
+  std::map<StateKey, dim_t> writers;
+  for (dim_t i = 0; i < count; ++i) {
+    for (const SequenceState& state : tasks_[i]->writes()) {
+      if (sequence.reached(state)) continue;
+      if (!writers.emplace(state_key(state), i).second) {
+        throw std::logic_error("TaskScheduler::run: Two tasks write the " +
+                               describe(state) + ".");
+      }
+    }
+  }
+
+  // the edges from every writer to the tasks reading what it writes.
+  std::vector<std::vector<dim_t>> readers(count);
+  std::vector<dim_t> waiting(count, 0);
+  for (dim_t i = 0; i < count; ++i) {
+    for (const SequenceState& state : tasks_[i]->reads()) {
+      if (sequence.reached(state)) continue;
+      auto writer_it = writers.find(state_key(state));
+      if (writer_it == writers.end()) {
+        throw std::logic_error("TaskScheduler::run: No task writes the " +
+                               describe(state) + ".");
+      }
+      if (writer_it->second == i) continue;
+      readers[writer_it->second].push_back(i);
+      ++waiting[i];
+    }
+  }
+
+  std::vector<dim_t> wave;
+  for (dim_t i = 0; i < count; ++i) {
+    if (waiting[i] == 0) wave.push_back(i);
+  }
+
+  std::vector<bool> solved(count, false);
+  std::vector<bool> failed(count, false);
+  while (!wave.empty()) {
+    // the tasks of a wave neither read nor write what the others write.
+    std::vector<char> solved_now(wave.size(), 0);
+    parallel_for(0, wave.size(), [&](const dim_t k) {
+      solved_now[k] = tasks_[wave[k]]->autosolve() ? 1 : 0;
+    });
+
+    std::vector<dim_t> next;
+    for (dim_t k = 0; k < wave.size(); ++k) {
+      const dim_t i = wave[k];
+      if (!solved_now[k]) {
+        failed[i] = true;
+        continue;
+      }
+      solved[i] = true;
+      for (const dim_t reader : readers[i]) {
+        if (--waiting[reader] == 0) next.push_back(reader);
+      }
+    }
+    std::sort(next.begin(), next.end());
+    wave.swap(next);
+  }
+
+  std::list<std::unique_ptr<Task>> unsolved;
+  std::vector<std::unique_ptr<Task>> pending;
+  for (dim_t i = 0; i < count; ++i) {
+    if (failed[i]) {
+      unsolved.push_back(std::move(tasks_[i]));
+    } else if (!solved[i]) {
+      pending.push_back(std::move(tasks_[i]));
+    }
+  }
+  tasks_.swap(pending);
+
+  if (unsolved.empty() && !tasks_.empty()) {
+    throw std::logic_error(
+        "TaskScheduler::run: Tasks are waiting for each other.");
+  }
+  return unsolved;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "spectral_sequence.h"
+#include "types.h"
+
+class Task;
+
+// The pending tasks of a session, run in the order of the states of the
+// spectral sequence they read and write (see Task::reads and Task::writes)
+// rather than in the order they were added. Every state a task reads that
+// does not hold yet must be written by exactly one pending task; the task
+// then waits for that one. A task runs as soon as everything it reads
+// holds; the tasks that become ready together run at once on the threads
+// of parallel_for, and since none of them reads what another one writes,
+// the results do not depend on the order in which they finish.
+class TaskScheduler
+{
+ public:
+  TaskScheduler();
+  ~TaskScheduler();
+
+  void add(std::unique_ptr<Task> task);
+  void clear();
+
+  inline dim_t size() const
+  {
+    return tasks_.size();
+  }
+
+  inline const std::vector<std::unique_ptr<Task>>& tasks() const
+  {
+    return tasks_;
+  }
+
+  // autosolves every task it can reach and drops the solved ones. Returns
+  // the tasks whose autosolve failed, which have to be solved otherwise
+  // before the tasks waiting for them can run. Throws if a task reads a
+  // state no pending task writes, or if the tasks wait for each other.
+  std::list<std::unique_ptr<Task>> run(const SpectralSequence& sequence);
+
+ private:
+  std::vector<std::unique_ptr<Task>> tasks_;
+};
@@ -0,0 +1,141 @@
+#include "thread_pool.h"
+
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(const unsigned int threads)
+{
+  for (unsigned int i = 1; i < threads; ++i) {
+    workers_.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::run(const dim_t begin, const dim_t end,
+                     const std::function<void(dim_t)>& f)
+{
+  std::lock_guard<std::mutex> run_lock(run_mutex_);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = &f;
+    next_ = begin;
+    end_ = end;
+    busy_ = static_cast<unsigned int>(workers_.size()) + 1;
+    error_ = nullptr;
+    ++generation_;
+  }
+  wake_.notify_all();
+
+  run_iterations();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return busy_ == 0; });
+  job_ = nullptr;
+
+  if (error_) std::rethrow_exception(error_);
+}
+
+void ThreadPool::work()
+{
+  unsigned long seen_generation = 0;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+      if (stop_) return;
+      seen_generation = generation_;
+    }
+
+    run_iterations();
+  }
+}
+
+void ThreadPool::run_iterations()
+{
+  for (;;) {
+    dim_t i;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (next_ >= end_ || error_) break;
+      i = next_++;
+    }
+
+    try {
+      (*job_)(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) error_ = std::current_exception();
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (--busy_ == 0) done_.notify_all();
+}
+
+static unsigned int default_thread_count()
+{
+  unsigned int count = std::thread::hardware_concurrency();
+  return count == 0 ? 1 : count;
+}
+
+static std::atomic<unsigned int> thread_count_(default_thread_count());
+// shared, so that a loop keeps its pool alive across set_thread_count.
+static std::shared_ptr<ThreadPool> pool_;
+static std::mutex pool_mutex_;
+static thread_local bool in_parallel_for_ = false;
+
+void set_thread_count(const unsigned int count)
+{
+  std::lock_guard<std::mutex> lock(pool_mutex_);
+  thread_count_ = count == 0 ? 1 : count;
+  pool_.reset();
+}
+
+unsigned int get_thread_count()
+{
+  return thread_count_;
+}
+
+void parallel_for(const dim_t begin, const dim_t end,
+                  const std::function<void(dim_t)>& f)
+{
+  if (in_parallel_for_ || thread_count_ == 1 || end <= begin + 1) {
+    for (dim_t i = begin; i < end; ++i) {
+      f(i);
+    }
+    return;
+  }
+
+  std::shared_ptr<ThreadPool> pool;
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    if (!pool_) pool_ = std::make_shared<ThreadPool>(thread_count_);
+    pool = pool_;
+  }
+
+  in_parallel_for_ = true;
+  try {
+    pool->run(begin, end, [&f](const dim_t i) {
+      in_parallel_for_ = true;
+      f(i);
+    });
+  } catch (...) {
+    in_parallel_for_ = false;
+    throw;
+  }
+  in_parallel_for_ = false;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+// A fixed set of worker threads that run the iterations of a loop together
+// with the calling thread.
+class ThreadPool
+{
+ public:
+  // a pool of threads - 1 workers, so that threads threads run a loop.
+  explicit ThreadPool(const unsigned int threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  inline unsigned int threads() const
+  {
+    return static_cast<unsigned int>(workers_.size()) + 1;
+  }
+
+  // runs f(begin), ..., f(end - 1) and returns once all of them have
+  // finished. The first exception thrown by f is rethrown here.
+  void run(const dim_t begin, const dim_t end,
+           const std::function<void(dim_t)>& f);
+
+ private:
+  void work();
+  void run_iterations();
+
+  std::vector<std::thread> workers_;
+
+  // serializes calls to run from different threads.
+  std::mutex run_mutex_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  const std::function<void(dim_t)>* job_ = nullptr;
+  dim_t next_ = 0;
+  dim_t end_ = 0;
+  unsigned int busy_ = 0;
+  unsigned long generation_ = 0;
+  bool stop_ = false;
+  std::exception_ptr error_;
+};
+
+// the number of threads parallel algorithms use, including the calling
+// thread. Defaults to the number of hardware threads.
+void set_thread_count(const unsigned int count);
+unsigned int get_thread_count();
+
+// runs f(begin), ..., f(end - 1) on the shared pool. Calls from inside such a
+// loop, and loops with a single thread or iteration, run serially.
+void parallel_for(const dim_t begin, const dim_t end,
+                  const std::function<void(dim_t)>& f);
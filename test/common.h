@@ -1,3 +1,20 @@
+#pragma once
+
 #include <string>
 
+#include "gtest/gtest.h"
+
+#include "../src/abelian_group.h"
+
 extern std::string TEST_DATA_DIR;
+
+// expects A and B to be the same group, with the same orders in the same
+// order.
+inline void expect_same_group(const AbelianGroup& A, const AbelianGroup& B)
+{
+  EXPECT_EQ(A.free_rank(), B.free_rank());
+  ASSERT_EQ(A.tor_rank(), B.tor_rank());
+  for (dim_t i = 0; i < A.tor_rank(); ++i) {
+    EXPECT_EQ(A(i), B(i));
+  }
+}
@@ -0,0 +1,102 @@
+#include <exception>
+#include <limits>
+
+#include <gmpxx.h>
+
+#include "gtest/gtest.h"
+
+#include "../src/hybrid_q.h"
+#include "../src/matrix.h"
+#include "../src/morphisms.h"
+#include "../src/smith.h"
+
+TEST(HybridQ, Arithmetic)
+{
+  EXPECT_EQ(HybridQ(1_mpq / 2), HybridQ(1) / HybridQ(2));
+  EXPECT_EQ(HybridQ(5_mpq / 6), HybridQ(1_mpq / 2) + HybridQ(1_mpq / 3));
+  EXPECT_EQ(HybridQ(-1_mpq / 6), HybridQ(1_mpq / 3) - HybridQ(1_mpq / 2));
+  EXPECT_EQ(HybridQ(1), HybridQ(2_mpq / 3) * HybridQ(3_mpq / 2));
+  EXPECT_EQ(HybridQ(-3_mpq / 4), HybridQ(3_mpq / 2) / HybridQ(-2));
+  EXPECT_EQ(1_mpq / 3, (HybridQ(2) / HybridQ(6)).get_mpq());
+  EXPECT_FALSE(HybridQ(0));
+  EXPECT_THROW(HybridQ(1) / HybridQ(0), std::logic_error);
+}
+
+TEST(HybridQ, Promotion)
+{
+  const mpz_class max = static_cast<long>(std::numeric_limits<std::int64_t>::max());
+  HybridQ x(max);
+  EXPECT_TRUE(x.is_small());
+
+  HybridQ y = x + HybridQ(1);
+  EXPECT_FALSE(y.is_small());
+  EXPECT_EQ(mpq_class(max + 1), y.get_mpq());
+
+  HybridQ z = y * y;
+  EXPECT_EQ(mpq_class((max + 1) * (max + 1)), z.get_mpq());
+
+  HybridQ w = z / y - HybridQ(1);
+  EXPECT_TRUE(w.is_small());
+  EXPECT_EQ(x, w);
+}
+
+TEST(HybridQ, Valuation)
+{
+  EXPECT_EQ(0, p_val_q(2, HybridQ(1_mpq / 3)));
+  EXPECT_EQ(2, p_val_q(5, HybridQ(-25_mpq / 2)));
+  EXPECT_EQ(-3, p_val_q(2, HybridQ(4_mpq / 32)));
+  EXPECT_EQ(std::numeric_limits<val_t>::max(), p_val_q(2, HybridQ(0)));
+  EXPECT_EQ(70, p_val_q(2, HybridQ(mpq_class(p_pow_z(2, 70)))));
+
+  const Prime<2> two(2);
+  EXPECT_EQ(0, p_val_q(two, HybridQ(1_mpq / 3)));
+  EXPECT_EQ(-3, p_val_q(two, HybridQ(4_mpq / 32)));
+  EXPECT_EQ(2, p_val_q(two, HybridQ(-12)));
+  EXPECT_EQ(70, p_val_q(two, HybridQ(mpq_class(p_pow_z(2, 70)))));
+}
+
+TEST(HybridQ, SmithReduceP)
+{
+  MatrixQ f = {{2, 4, 1_mpq / 3}, {6, 8, 3}, {0, 12, 0}};
+  Matrix<HybridQ> g = to_hybrid_q(f);
+  MatrixQ f_from = MatrixQ::identity(3);
+  Matrix<HybridQ> g_from = to_hybrid_q(f_from);
+
+  auto to_X = MatrixQRefList();
+  auto from_X = MatrixQRefList({f_from});
+  auto to_Y = MatrixQRefList();
+  auto from_Y = MatrixQRefList();
+  smith_reduce_p(2, f, to_X, from_X, to_Y, from_Y);
+
+  auto to_X_h = MatrixRefList<HybridQ>();
+  auto from_X_h = MatrixRefList<HybridQ>({g_from});
+  auto to_Y_h = MatrixRefList<HybridQ>();
+  auto from_Y_h = MatrixRefList<HybridQ>();
+  smith_reduce_p(2, g, to_X_h, from_X_h, to_Y_h, from_Y_h);
+
+  EXPECT_EQ(f, to_rational(g));
+  EXPECT_EQ(f_from, to_rational(g_from));
+}
+
+TEST(HybridQ, Image)
+{
+  AbelianGroup X(0, 2);
+  X(0) = 2;
+  X(1) = 2;
+
+  AbelianGroup Y(0, 2);
+  Y(0) = 2;
+  Y(1) = 2;
+
+  MatrixQ f = {{0, 6}, {0, 0}};
+
+  GroupWithMorphisms I_q = compute_image(3, f, X, Y);
+
+  CoefficientsScope coefficients(Coefficients::small_rational);
+  GroupWithMorphisms I_h = compute_image(3, f, X, Y);
+
+  ASSERT_EQ(I_q.group.tor_rank(), I_h.group.tor_rank());
+  EXPECT_EQ(I_q.group(0), I_h.group(0));
+  EXPECT_EQ(I_q.maps_to[0], I_h.maps_to[0]);
+  EXPECT_EQ(I_q.maps_from[1], I_h.maps_from[1]);
+}
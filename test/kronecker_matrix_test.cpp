@@ -0,0 +1,57 @@
+#include <exception>
+
+#include <gmpxx.h>
+
+#include "gtest/gtest.h"
+
+#include "../src/kronecker_matrix.h"
+#include "../src/matrix.h"
+#include "../src/sparse_matrix.h"
+
+// A \otimes B, computed entry by entry.
+static MatrixQ kronecker(const MatrixQ& A, const MatrixQ& B)
+{
+  MatrixQ result(A.height() * B.height(), A.width() * B.width());
+  for (dim_t i = 0; i < result.height(); ++i) {
+    for (dim_t j = 0; j < result.width(); ++j) {
+      result(i, j) = A(i / B.height(), j / B.width()) *
+                     B(i % B.height(), j % B.width());
+    }
+  }
+  return result;
+}
+
+TEST(KroneckerMatrix, Entries)
+{
+  MatrixQ A = {{1, 0}, {0, 2}, {3, 0}};
+  MatrixQ B = {{0, 1_mpq / 2, 4}, {5, 0, 0}};
+  KroneckerMatrixQ k{SparseMatrixQ(A), SparseMatrixQ(B)};
+
+  EXPECT_EQ(6u, k.height());
+  EXPECT_EQ(6u, k.width());
+  EXPECT_EQ(kronecker(A, B), k);
+  EXPECT_EQ(MatrixQ::identity(6),
+            KroneckerMatrixQ(SparseMatrixQ::identity(2),
+                             SparseMatrixQ::identity(3)));
+}
+
+TEST(KroneckerMatrix, Products)
+{
+  MatrixQ A = {{1, 0}, {0, 2}, {3, 0}};
+  MatrixQ B = {{0, 1_mpq / 2, 4}, {5, 0, 0}};
+  KroneckerMatrixQ k{SparseMatrixQ(A), SparseMatrixQ(B)};
+  MatrixQ dense = kronecker(A, B);
+
+  MatrixQ f(6, 2);
+  MatrixQ g(3, 6);
+  for (dim_t i = 0; i < 6; ++i) {
+    f(i, 0) = i;
+    f(i, 1) = mpq_class(1, i + 1);
+    g(i % 3, i) = i + 1;
+    g((i + 1) % 3, i) = -2;
+  }
+
+  EXPECT_EQ(dense * f, k * f);
+  EXPECT_EQ(g * dense, g * k);
+  EXPECT_THROW(k * g, std::logic_error);
+}
@@ -4,6 +4,7 @@
 #include "gtest/gtest.h"
 
 #include "../src/matrix.h"
+#include "../src/thread_pool.h"
 
 TEST(Matrix, Properties)
 {
@@ -134,6 +135,93 @@ TEST(Matrix, Composition)
   EXPECT_EQ(C_ref, C);
 }
 
+TEST(Matrix, CompositionTiled)
+{
+  // large enough to be split into tiles and run on several threads.
+  const dim_t n = 70;
+  MatrixQ A(n, n + 3);
+  MatrixQ B(n + 3, n - 5);
+  for (dim_t i = 0; i < A.height(); ++i) {
+    for (dim_t j = 0; j < A.width(); ++j) {
+      A(i, j) = mpq_class(static_cast<long>((i * 7 + j) % 5) - 2) / (j % 3 + 1);
+    }
+  }
+  for (dim_t i = 0; i < B.height(); ++i) {
+    for (dim_t j = 0; j < B.width(); ++j) {
+      B(i, j) = mpq_class(static_cast<long>((i + j * 3) % 7) - 3) / (i % 2 + 1);
+    }
+  }
+
+  MatrixQ C_ref(A.height(), B.width());
+  for (dim_t i = 0; i < A.height(); ++i) {
+    for (dim_t j = 0; j < B.width(); ++j) {
+      for (dim_t k = 0; k < A.width(); ++k) {
+        C_ref(i, j) += A(i, k) * B(k, j);
+      }
+    }
+  }
+
+  unsigned int threads = get_thread_count();
+  set_thread_count(4);
+  EXPECT_EQ(C_ref, A * B);
+  set_thread_count(1);
+  EXPECT_EQ(C_ref, A * B);
+  set_thread_count(threads);
+}
+
+TEST(Matrix, RowColVectors)
+{
+  MatrixQ A = {{1, 2, 3}, {4, 5, 6}};
+  const MatrixQ& B = A;
+
+  MatrixVector<const mpq_class> row = B.row(1);
+  MatrixVector<const mpq_class> col = B.col(2);
+  EXPECT_EQ(3, row.size());
+  EXPECT_EQ(2, col.size());
+  EXPECT_EQ(4, row[0]);
+  EXPECT_EQ(6, row[2]);
+  EXPECT_EQ(3, col[0]);
+  EXPECT_EQ(6, col[1]);
+
+  // reads go to the entries themselves.
+  EXPECT_EQ(&B(1, 2), &row[2]);
+  EXPECT_EQ(&B(1, 2), &col[1]);
+
+  A.col(0)[1] = 7;
+  A.row(0)[1] = 8;
+  EXPECT_EQ(MatrixQ({{1, 8, 3}, {7, 5, 6}}), A);
+}
+
+TEST(Matrix, ColumnMajor)
+{
+  MatrixQ A = {{1, 2, 3}, {4, 5, 6}};
+  MatrixQ B = A;
+  B.set_layout(Layout::column_major);
+
+  EXPECT_EQ(Layout::column_major, B.layout());
+  EXPECT_EQ(A, B);
+  EXPECT_EQ(&B(0, 1) + 1, &B(1, 1));
+  EXPECT_EQ(&B(1, 0), &B.col(0)[1]);
+  EXPECT_EQ(&B(1, 2), &B.row(1)[2]);
+
+  A.row_add(0, 1, 2).col_add(2, 0, -1).row_swap(0, 1).col_mul(1, 3);
+  B.row_add(0, 1, 2).col_add(2, 0, -1).row_swap(0, 1).col_mul(1, 3);
+  EXPECT_EQ(A, B);
+
+  MatrixQ C = {{1, 0}, {2, 1}, {0, 3}};
+  EXPECT_EQ(A * C, B * C);
+  C.set_layout(Layout::column_major);
+  EXPECT_EQ(A * C, B * C);
+
+  B.set_layout(Layout::row_major);
+  EXPECT_EQ(Layout::row_major, B.layout());
+  EXPECT_EQ(A, B);
+
+  MatrixQ D(2, 3, Layout::column_major);
+  D(0, 0, 2, 3) = A;
+  EXPECT_EQ(A, D);
+}
+
 TEST(MatrixSlice, DimensionMismatch)
 {
   MatrixQ A(2, 2);
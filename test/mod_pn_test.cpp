@@ -0,0 +1,133 @@
+#include <exception>
+#include <limits>
+
+#include <gmpxx.h>
+
+#include "gtest/gtest.h"
+
+#include "../src/matrix.h"
+#include "../src/mod_pn.h"
+#include "../src/morphisms.h"
+#include "../src/smith.h"
+
+TEST(ModPN, Context)
+{
+  EXPECT_EQ(31, ModPN::max_precision(2));
+  EXPECT_EQ(20, ModPN::max_precision(3));
+  EXPECT_THROW(ModPN::Context(2, 32), std::logic_error);
+
+  {
+    ModPN::Context outer(2, 4);
+    {
+      ModPN::Context inner(3, 2);
+      EXPECT_EQ(9, ModPN::modulus());
+    }
+    EXPECT_EQ(2, ModPN::prime());
+    EXPECT_EQ(16, ModPN::modulus());
+  }
+}
+
+TEST(ModPN, Arithmetic)
+{
+  ModPN::Context context(2, 4);
+
+  EXPECT_EQ(ModPN(1), ModPN(3) * ModPN(11));
+  EXPECT_EQ(ModPN(0), ModPN(9) + ModPN(7));
+  EXPECT_EQ(-1_mpz, (ModPN(3) - ModPN(4)).get_mpz());
+  EXPECT_EQ(ModPN(1), ModPN(1_mpq / 3) * 3);
+  EXPECT_EQ(ModPN(3), ModPN(17_mpz) * 3);
+  EXPECT_THROW(ModPN(1_mpq / 2), std::logic_error);
+}
+
+TEST(ModPN, Division)
+{
+  ModPN::Context context(2, 4);
+
+  EXPECT_EQ(ModPN(3), ModPN(12) / ModPN(4));
+  EXPECT_EQ(ModPN(1), ModPN(12) / ModPN(12));
+  EXPECT_EQ(ModPN(0), ModPN(0) / ModPN(2));
+  EXPECT_THROW(ModPN(2) / ModPN(4), std::logic_error);
+  EXPECT_THROW(ModPN(2) / ModPN(0), std::logic_error);
+}
+
+TEST(ModPN, Valuation)
+{
+  ModPN::Context context(3, 5);
+
+  EXPECT_EQ(0, p_val_q(3, ModPN(5)));
+  EXPECT_EQ(2, p_val_q(3, ModPN(-18)));
+  EXPECT_EQ(std::numeric_limits<val_t>::max(), p_val_q(3, ModPN(243)));
+  EXPECT_THROW(p_val_q(2, ModPN(1)), std::logic_error);
+  EXPECT_THROW(p_val_q(Prime<2>(2), ModPN(1)), std::logic_error);
+
+  ModPN::Context context_2(2, 10);
+  EXPECT_EQ(3, p_val_q(Prime<2>(2), ModPN(-24)));
+  EXPECT_EQ(std::numeric_limits<val_t>::max(),
+            p_val_q(Prime<2>(2), ModPN(1024)));
+}
+
+TEST(ModPN, SmithReduceP)
+{
+  ModPN::Context context(2, 8);
+
+  Matrix<ModPN> f = to_mod_pn(MatrixQ({{2, 4}, {6, 8}}));
+
+  auto to_X = MatrixRefList<ModPN>();
+  auto from_X = MatrixRefList<ModPN>();
+  auto to_Y = MatrixRefList<ModPN>();
+  auto from_Y = MatrixRefList<ModPN>();
+
+  smith_reduce_p(2, f, to_X, from_X, to_Y, from_Y);
+
+  EXPECT_EQ(MatrixQ({{2, 0}, {0, 4}}), to_rational(f));
+}
+
+TEST(ModPN, FreeGroupFallsBackToRational)
+{
+  // 2^10 is 0 in Z/2^(0 + 8), which would make the cokernel Z.
+  AbelianGroup Z(1, 0);
+  MatrixQ f = {{1024}};
+
+  CoefficientsScope coefficients(Coefficients::mod_p_power);
+  GroupWithMorphisms C =
+      compute_cokernel(2, f, Z, MatrixQRefList(), MatrixQRefList());
+  AbelianGroup C_group = compute_cokernel_group(2, f, Z);
+  GroupWithMorphisms I = compute_image(2, f, Z, Z);
+
+  EXPECT_EQ(0u, C.group.free_rank());
+  ASSERT_EQ(1u, C.group.tor_rank());
+  EXPECT_EQ(10u, C.group(0));
+  EXPECT_EQ(0u, C_group.free_rank());
+  ASSERT_EQ(1u, C_group.tor_rank());
+  EXPECT_EQ(10u, C_group(0));
+  EXPECT_EQ(1u, I.group.free_rank());
+  EXPECT_EQ(0u, I.group.tor_rank());
+}
+
+TEST(ModPN, Kernel)
+{
+  AbelianGroup X(0, 2);
+  X(0) = 1;
+  X(1) = 2;
+
+  AbelianGroup Y(0, 1);
+  Y(0) = 2;
+
+  MatrixQ f = {{5, 2}};
+  MatrixQList from_X = {MatrixQ::identity(2)};
+
+  GroupWithMorphisms K_q =
+      compute_kernel(5, f, X, Y, MatrixQRefList(), ref(from_X));
+
+  CoefficientsScope coefficients(Coefficients::mod_p_power);
+  GroupWithMorphisms K_pn =
+      compute_kernel(5, f, X, Y, MatrixQRefList(), ref(from_X));
+
+  EXPECT_EQ(K_q.group.free_rank(), K_pn.group.free_rank());
+  ASSERT_EQ(K_q.group.tor_rank(), K_pn.group.tor_rank());
+  EXPECT_EQ(K_q.group(0), K_pn.group(0));
+
+  // the default margin gives N = 2 + 8.
+  ModPN::Context context(5, 10);
+  EXPECT_EQ(to_mod_pn(K_q.maps_from[0]), to_mod_pn(K_pn.maps_from[0]));
+}
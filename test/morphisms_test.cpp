@@ -1,7 +1,12 @@
+#include <vector>
+
 #include "gtest/gtest.h"
 
+#include "common.h"
+
 #include "../src/matrix.h"
 #include "../src/morphisms.h"
+#include "../src/smith.h"
 
 TEST(Cokernel, Diagonal)
 {
@@ -107,3 +112,155 @@ TEST(Morphism, Zero)
   MatrixQ h = {{2, 4, 0}, {12, 0, 8}};
   EXPECT_TRUE(morphism_zero(2, h, Y));
 }
+
+// X = Z/8 + Z^2, Y = Z/2 + Z/8 + Z and a few maps from X to Y, one of them
+// with a denominator prime to 2.
+class ThreeMaps : public ::testing::Test
+{
+ protected:
+  ThreeMaps()
+      : X_(2, 1),
+        Y_(1, 2),
+        maps_({
+            {{1, 0, 1}, {2, 4, 0}, {0, 2, 6}},
+            {{0, 0, 0}, {4, 0, 2}, {0, 0, 0}},
+            {{1, 1_mpq / 5, 0}, {0, 6, 2}, {0, 0, 4}},
+        })
+  {
+    X_(0) = 3;
+    Y_(0) = 1;
+    Y_(1) = 3;
+  }
+
+  AbelianGroup X_;
+  AbelianGroup Y_;
+  std::vector<MatrixQ> maps_;
+};
+
+TEST_F(ThreeMaps, GroupsOnly)
+{
+  std::vector<MatrixQ> maps = maps_;
+  maps.push_back({{0, 1, 0}, {8, 0, 0}, {0, 0, 0}});
+
+  for (Coefficients coefficients :
+       {Coefficients::rational, Coefficients::small_rational,
+        Coefficients::mod_p_power}) {
+    CoefficientsScope scope(coefficients);
+
+    for (const MatrixQ& f : maps) {
+      expect_same_group(
+          compute_cokernel(2, f, Y_, MatrixQRefList(), MatrixQRefList()).group,
+          compute_cokernel_group(2, f, Y_));
+      expect_same_group(compute_image(2, f, X_, Y_).group,
+                        compute_image_group(2, f, Y_));
+      expect_same_group(compute_image(3, f, X_, Y_).group,
+                        compute_image_group(3, f, Y_));
+    }
+  }
+}
+
+TEST_F(ThreeMaps, SparseSmith)
+{
+  for (const MatrixQ& f : maps_) {
+    MatrixQList to_Y = {MatrixQ::identity(Y_.rank())};
+    MatrixQList from_X = {MatrixQ::identity(X_.rank())};
+
+    GroupWithMorphisms C =
+        compute_cokernel(2, f, Y_, ref(to_Y), MatrixQRefList());
+    GroupWithMorphisms K =
+        compute_kernel(2, f, X_, Y_, MatrixQRefList(), ref(from_X));
+    GroupWithMorphisms I = compute_image(2, f, X_, Y_);
+
+    SmithEngineScope engine(SmithEngine::sparse);
+    GroupWithMorphisms C_sparse =
+        compute_cokernel(2, f, Y_, ref(to_Y), MatrixQRefList());
+    GroupWithMorphisms K_sparse =
+        compute_kernel(2, f, X_, Y_, MatrixQRefList(), ref(from_X));
+    GroupWithMorphisms I_sparse = compute_image(2, f, X_, Y_);
+
+    expect_same_group(C.group, C_sparse.group);
+    expect_same_group(K.group, K_sparse.group);
+    expect_same_group(I.group, I_sparse.group);
+
+    // f vanishes in the cokernel, and maps the kernel to zero.
+    EXPECT_TRUE(morphism_zero(2, C_sparse.maps_to[0] * f, C_sparse.group));
+    EXPECT_TRUE(morphism_zero(2, f * K_sparse.maps_from[0], Y_));
+  }
+}
+
+TEST_F(ThreeMaps, KernelAndCokernel)
+{
+  for (const MatrixQ& f : maps_) {
+    MatrixQList to_Y = {MatrixQ::identity(Y_.rank())};
+    MatrixQList from_X = {MatrixQ::identity(X_.rank())};
+
+    GroupWithMorphisms C =
+        compute_cokernel(2, f, Y_, ref(to_Y), MatrixQRefList());
+    GroupWithMorphisms K =
+        compute_kernel(2, f, X_, Y_, MatrixQRefList(), ref(from_X));
+    KernelAndCokernel KC = compute_kernel_and_cokernel(
+        2, f, X_, Y_, MatrixQRefList(), ref(from_X), ref(to_Y),
+        MatrixQRefList());
+
+    // the same reduction, so the same bases.
+    expect_same_group(K.group, KC.kernel.group);
+    expect_same_group(C.group, KC.cokernel.group);
+    EXPECT_EQ(K.maps_from, KC.kernel.maps_from);
+    EXPECT_EQ(C.maps_to, KC.cokernel.maps_to);
+  }
+}
+
+TEST_F(ThreeMaps, ImageMatchesKernelReference)
+{
+  // and the zero map, whose image is trivial.
+  std::vector<MatrixQ> maps = maps_;
+  maps.push_back(MatrixQ(Y_.rank(), X_.rank()));
+
+  for (const MatrixQ& f : maps) {
+    GroupWithMorphisms I = compute_image(2, f, X_, Y_);
+    GroupWithMorphisms I_reference =
+        compute_image_by_kernel<mpq_class>(2, f, X_, Y_);
+    expect_same_group(I_reference.group, I.group);
+
+    // f is the projection onto the image followed by its inclusion, and the
+    // representatives project to the generators.
+    const MatrixQ& projection = I.maps_to[0];
+    const MatrixQ& inclusion = I.maps_from[0];
+    const MatrixQ& representatives = I.maps_from[1];
+    EXPECT_TRUE(morphism_equal(2, inclusion * projection, f, Y_));
+    EXPECT_TRUE(morphism_equal(2, projection * representatives,
+                               MatrixQ::identity(I.group.rank()), I.group));
+    EXPECT_EQ(f * representatives, inclusion);
+  }
+}
+
+TEST(Morphism, PreparedLift)
+{
+  AbelianGroup Y(0, 3);
+  Y(0) = 1;
+  Y(1) = 3;
+  Y(2) = 2;  // Y = Z/2 + Z/8 + Z/4
+
+  MatrixQ map = {{1, 0}, {1, 2}, {0, 4}};
+  // maps that lift: map * g, plus relations of Y.
+  const MatrixQList fs = {
+      map * MatrixQ({{3, 1}, {1, 5}}),
+      {{4}, {12}, {8}},
+      {{0, 0}, {0, 8}, {0, 0}},
+  };
+
+  for (Coefficients coefficients :
+       {Coefficients::rational, Coefficients::small_rational,
+        Coefficients::mod_p_power}) {
+    CoefficientsScope scope(coefficients);
+
+    PreparedLift prepared(2, map, Y);
+    MatrixQList lifts = prepared.lift(fs);
+    ASSERT_EQ(fs.size(), lifts.size());
+    for (dim_t k = 0; k < fs.size(); ++k) {
+      EXPECT_EQ(lift_from_free(2, fs[k], map, Y), lifts[k]);
+      EXPECT_EQ(lifts[k], prepared.lift(fs[k]));
+      EXPECT_TRUE(morphism_equal(2, map * lifts[k], fs[k], Y));
+    }
+  }
+}
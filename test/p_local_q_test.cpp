@@ -0,0 +1,97 @@
+#include <exception>
+#include <limits>
+
+#include <gmpxx.h>
+
+#include "gtest/gtest.h"
+
+#include "../src/abelian_group.h"
+#include "../src/matrix.h"
+#include "../src/morphisms.h"
+#include "../src/p_local_q.h"
+#include "../src/smith.h"
+
+TEST(PLocalQ, Representation)
+{
+  PLocalQ::Context context(2);
+
+  PLocalQ x(12_mpq / 5);
+  EXPECT_EQ(2, x.valuation());
+  EXPECT_EQ(HybridQ(3_mpq / 5), x.unit());
+  EXPECT_EQ(12_mpq / 5, x.get_mpq());
+
+  PLocalQ y(3_mpq / 8);
+  EXPECT_EQ(-3, y.valuation());
+  EXPECT_EQ(HybridQ(3), y.unit());
+
+  EXPECT_FALSE(PLocalQ(0));
+  EXPECT_EQ(std::numeric_limits<val_t>::max(), PLocalQ(0).valuation());
+  EXPECT_EQ(PLocalQ(8), PLocalQ::power(3));
+}
+
+TEST(PLocalQ, Arithmetic)
+{
+  PLocalQ::Context context(2);
+
+  PLocalQ sum = PLocalQ(2) + PLocalQ(6);
+  EXPECT_EQ(3, sum.valuation());
+  EXPECT_EQ(8_mpq, sum.get_mpq());
+
+  EXPECT_EQ(PLocalQ(0), PLocalQ(6) - PLocalQ(6));
+  EXPECT_EQ(PLocalQ(1_mpq / 3), PLocalQ(1_mpq / 2) - PLocalQ(1_mpq / 6));
+  EXPECT_EQ(PLocalQ(9_mpq / 2), PLocalQ(3_mpq / 4) * PLocalQ(6));
+  EXPECT_EQ(5, (PLocalQ(12) * PLocalQ(8)).valuation());
+  EXPECT_EQ(PLocalQ(-3_mpq / 4), PLocalQ(3) / PLocalQ(-4));
+  EXPECT_EQ(PLocalQ(0), PLocalQ(0) * PLocalQ(3));
+  EXPECT_THROW(PLocalQ(1) / PLocalQ(0), std::logic_error);
+}
+
+TEST(PLocalQ, Valuation)
+{
+  PLocalQ::Context context(5);
+
+  EXPECT_EQ(p_val_q(5, -25_mpq / 2), p_val_q(5, PLocalQ(-25_mpq / 2)));
+  EXPECT_EQ(p_val_q(5, 3_mpq / 125), p_val_q(5, PLocalQ(3_mpq / 125)));
+  EXPECT_THROW(p_val_q(2, PLocalQ(1)), std::logic_error);
+}
+
+TEST(PLocalQ, TorsionMatrix)
+{
+  PLocalQ::Context context(3);
+
+  AbelianGroup X(2, 3);
+  X(0) = 2;
+  X(1) = 1;
+  X(2) = 3;
+
+  Matrix<PLocalQ> torsion = X.torsion_matrix<PLocalQ>(3);
+  EXPECT_EQ(to_p_local_q(MatrixQ({{9, 0, 0}, {0, 3, 0}, {0, 0, 27}})),
+            torsion);
+  EXPECT_EQ(3, torsion(2, 2).valuation());
+}
+
+TEST(PLocalQ, Kernel)
+{
+  PLocalQ::Context context(5);
+
+  AbelianGroup X(0, 2);
+  X(0) = 1;
+  X(1) = 2;
+
+  AbelianGroup Y(0, 1);
+  Y(0) = 2;
+
+  MatrixQ f = {{5, 2}};
+  MatrixQList from_X = {MatrixQ::identity(2)};
+  Matrix<PLocalQ> f_p = to_p_local_q(f);
+  MatrixList<PLocalQ> from_X_p = {to_p_local_q(from_X[0])};
+
+  GroupWithMorphisms K =
+      compute_kernel(5, f, X, Y, MatrixQRefList(), ref(from_X));
+  BasicGroupWithMorphisms<PLocalQ> K_p =
+      compute_kernel(5, f_p, X, Y, MatrixRefList<PLocalQ>(), ref(from_X_p));
+
+  ASSERT_EQ(K.group.tor_rank(), K_p.group.tor_rank());
+  EXPECT_EQ(K.group(0), K_p.group(0));
+  EXPECT_EQ(K.maps_from[0], to_rational(K_p.maps_from[0]));
+}
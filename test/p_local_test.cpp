@@ -1,9 +1,11 @@
 #include <limits>
+#include <vector>
 
 #include <gmpxx.h>
 
 #include "gtest/gtest.h"
 
+#include "../src/matrix.h"
 #include "../src/p_local.h"
 
 TEST(PLocal, ValuationInt)
@@ -25,6 +27,21 @@ TEST(PLocal, PowInt)
 {
   EXPECT_EQ(1_mpz, p_pow_z(13, 0));
   EXPECT_EQ(25_mpz, p_pow_z(5, 2));
+  EXPECT_EQ(0_mpz, p_pow_z(2, std::numeric_limits<val_t>::max()));
+}
+
+TEST(PLocal, PowTable)
+{
+  const mpz_class& seven = p_pow_z(7, 1);
+  EXPECT_EQ(&seven, &p_pow_z(7, 1));
+  EXPECT_EQ(p_pow_z(7, 200), p_pow_z(7, 100) * p_pow_z(7, 100));
+  EXPECT_EQ(7_mpz, seven);
+
+  mpz_class large;
+  mpz_ui_pow_ui(large.get_mpz_t(), 2, 5000);
+  EXPECT_EQ(large, p_pow_z(2, 5000));
+  EXPECT_EQ(1 / mpq_class(large), p_pow_q(2, -5000));
+  EXPECT_EQ(mpq_class(large), p_pow_q(2, 5000));
 }
 
 TEST(PLocal, PowRational)
@@ -33,3 +50,48 @@ TEST(PLocal, PowRational)
   EXPECT_EQ(1/9_mpq, p_pow_q(3, -2));
   EXPECT_EQ(0_mpq, p_pow_q(2, std::numeric_limits<val_t>::max()));
 }
+
+TEST(PLocal, ValuationLarge)
+{
+  EXPECT_EQ(200, p_val_z(2, p_pow_z(2, 200) * 3));
+  EXPECT_EQ(150, p_val_z(3, -p_pow_z(3, 150) * 7));
+  EXPECT_EQ(-40, p_val_q(5, 2 / mpq_class(p_pow_z(5, 40))));
+}
+
+TEST(PLocal, ValuationRowCol)
+{
+  MatrixQ f = {{4, 0, 1_mpq / 2}, {3, 12, 8}};
+  std::vector<val_t> valuations;
+
+  p_val_row(2, f, 0, 0, valuations);
+  EXPECT_EQ(std::vector<val_t>({2, std::numeric_limits<val_t>::max(), -1}),
+            valuations);
+  p_val_row(2, f, 1, 1, valuations);
+  EXPECT_EQ(std::vector<val_t>({2, 3}), valuations);
+  p_val_col(3, f, 1, 0, valuations);
+  EXPECT_EQ(std::vector<val_t>({std::numeric_limits<val_t>::max(), 1}),
+            valuations);
+
+  // the kernels for a runtime prime and for the fixed prime 2 agree.
+  std::vector<val_t> expected;
+  p_val_row(Prime<0>(2), f, 0, 0, expected);
+  p_val_row(Prime<2>(2), f, 0, 0, valuations);
+  EXPECT_EQ(expected, valuations);
+  p_val_col(Prime<0>(3), f, 1, 0, valuations);
+  EXPECT_EQ(std::vector<val_t>({std::numeric_limits<val_t>::max(), 1}),
+            valuations);
+}
+
+TEST(PLocal, FixedPrime)
+{
+  const Prime<2> two(2);
+
+  EXPECT_EQ(p_val_q(2, 12_mpq / 5), p_val_q(two, 12_mpq / 5));
+  EXPECT_EQ(p_val_q(2, 3_mpq / 8), p_val_q(two, 3_mpq / 8));
+  EXPECT_EQ(std::numeric_limits<val_t>::max(), p_val_q(two, 0_mpq));
+
+  const mpq_class x(3, 8);
+  EXPECT_EQ(3_mpq / 2, mul_p_pow(two, x, 2));
+  EXPECT_EQ(3_mpq / 32, div_p_pow(two, x, 2));
+  EXPECT_EQ(81_mpq / 8, mul_p_pow(Prime<0>(3), x, 3));
+}
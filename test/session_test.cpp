@@ -1,10 +1,68 @@
 #include "gtest/gtest.h"
 
+#include <cstdio>
+#include <random>
+#include <sstream>
 #include <string>
 
 #include "common.h"
 
 #include "../src/session.h"
+#include "../src/smith.h"
+
+// a fresh path in the temporary directory of the tests. The file there and
+// its temporary copy, see Session::save_checkpoint, are removed when the
+// ScopedFile goes out of scope, even if an assertion fails first.
+struct ScopedFile
+{
+  explicit ScopedFile(const std::string& name)
+      : path(::testing::TempDir() + name + "_" +
+             std::to_string(std::random_device()()) + ".bin")
+  {
+  }
+
+  ~ScopedFile()
+  {
+    std::remove(path.c_str());
+    std::remove((path + ".tmp").c_str());
+  }
+
+  ScopedFile(const ScopedFile&) = delete;
+  ScopedFile& operator=(const ScopedFile&) = delete;
+
+  const std::string path;
+};
+
+// expects both sessions to be at the same q, with the same kernels and
+// cokernels on every page they reached.
+static void expect_same_groups(Session& expected, Session& actual)
+{
+  ASSERT_EQ(expected.get_current_q(), actual.get_current_q());
+  const SpectralSequence& E = expected.get_sequence();
+  const SpectralSequence& A = actual.get_sequence();
+
+  for (deg_t q = 0; q <= expected.get_current_q(); ++q) {
+    std::pair<deg_t, deg_t> bounds = E.get_bounds(q);
+    for (deg_t s = bounds.first; s <= bounds.second; ++s) {
+      for (deg_t p = 0; p <= 2 * expected.get_current_q() + 4; ++p) {
+        TrigradedIndex pqs(p, q, s);
+        for (dim_t r = 2; r <= static_cast<dim_t>(q) + 3; ++r) {
+          for (bool kernel : {true, false}) {
+            SequenceState state = {pqs, kernel, r};
+            ASSERT_EQ(E.reached(state), A.reached(state)) << pqs;
+            if (!E.reached(state)) continue;
+            if (kernel) {
+              expect_same_group(E.get_kernel(pqs, r), A.get_kernel(pqs, r));
+            } else {
+              expect_same_group(E.get_cokernel(pqs, r),
+                                A.get_cokernel(pqs, r));
+            }
+          }
+        }
+      }
+    }
+  }
+}
 
 TEST(SessionInit, Parse)
 {
@@ -15,6 +73,18 @@ TEST(SessionInit, Parse)
                   10);
 }
 
+TEST(SessionInit, CoefficientsStayLocal)
+{
+  std::string TEST_DATA_PATH = TEST_DATA_DIR + "SessionInitParse/";
+  Session session(2, TEST_DATA_PATH + "ranks.dat",
+                  TEST_DATA_PATH + "v_inclusions.dat",
+                  TEST_DATA_PATH + "r_operations.dat.",
+                  10, Coefficients::mod_p_power);
+  EXPECT_EQ(Coefficients::rational, get_coefficients());
+  session.step();
+  EXPECT_EQ(Coefficients::rational, get_coefficients());
+}
+
 TEST(SessionInit, Step)
 {
   std::string TEST_DATA_PATH = TEST_DATA_DIR + "SessionInitParse/";
@@ -59,3 +129,100 @@ TEST(SessionInit, ThreeSteps)
     //session.step();
   //};
 //}
+
+TEST(SessionInit, ThreeStepsModPN)
+{
+  std::string TEST_DATA_PATH = TEST_DATA_DIR + "SessionInitParse/";
+  Session session(2, TEST_DATA_PATH + "ranks.dat",
+                  TEST_DATA_PATH + "v_inclusions.dat",
+                  TEST_DATA_PATH + "r_operations.dat.",
+                  10, Coefficients::mod_p_power);
+  Session rational(2, TEST_DATA_PATH + "ranks.dat",
+                   TEST_DATA_PATH + "v_inclusions.dat",
+                   TEST_DATA_PATH + "r_operations.dat.",
+                   10);
+  for (int i = 0; i < 3; ++i) {
+    session.step();
+    rational.step();
+  }
+  expect_same_groups(rational, session);
+}
+
+TEST(SessionInit, ThreeStepsSmallRational)
+{
+  std::string TEST_DATA_PATH = TEST_DATA_DIR + "SessionInitParse/";
+  Session session(2, TEST_DATA_PATH + "ranks.dat",
+                  TEST_DATA_PATH + "v_inclusions.dat",
+                  TEST_DATA_PATH + "r_operations.dat.",
+                  10, Coefficients::small_rational);
+  Session rational(2, TEST_DATA_PATH + "ranks.dat",
+                   TEST_DATA_PATH + "v_inclusions.dat",
+                   TEST_DATA_PATH + "r_operations.dat.",
+                   10);
+  for (int i = 0; i < 3; ++i) {
+    session.step();
+    rational.step();
+  }
+  expect_same_groups(rational, session);
+
+  // both compute exactly in Q, so even the maps agree.
+  std::stringstream expected, actual;
+  rational.save_checkpoint(expected);
+  session.save_checkpoint(actual);
+  EXPECT_EQ(expected.str(), actual.str());
+}
+
+TEST(SessionInit, ThreeStepsSparseSmith)
+{
+  std::string TEST_DATA_PATH = TEST_DATA_DIR + "SessionInitParse/";
+  Session session(2, TEST_DATA_PATH + "ranks.dat",
+                  TEST_DATA_PATH + "v_inclusions.dat",
+                  TEST_DATA_PATH + "r_operations.dat.",
+                  10);
+  Session dense(2, TEST_DATA_PATH + "ranks.dat",
+                TEST_DATA_PATH + "v_inclusions.dat",
+                TEST_DATA_PATH + "r_operations.dat.",
+                10);
+  for (int i = 0; i < 3; ++i) {
+    {
+      SmithEngineScope engine(SmithEngine::sparse);
+      session.step();
+    }
+    dense.step();
+  }
+  expect_same_groups(dense, session);
+}
+
+TEST(SessionInit, CheckpointRestore)
+{
+  std::string TEST_DATA_PATH = TEST_DATA_DIR + "SessionInitParse/";
+  const ScopedFile checkpoint("session_checkpoint");
+  const std::string& checkpoint_path = checkpoint.path;
+
+  Session session(2, TEST_DATA_PATH + "ranks.dat",
+                  TEST_DATA_PATH + "v_inclusions.dat",
+                  TEST_DATA_PATH + "r_operations.dat.",
+                  10);
+  session.set_checkpoint_path(checkpoint_path);
+  session.step();
+  session.step();
+
+  Session restored(2, TEST_DATA_PATH + "ranks.dat",
+                   TEST_DATA_PATH + "v_inclusions.dat",
+                   TEST_DATA_PATH + "r_operations.dat.",
+                   10);
+  restored.load_checkpoint(checkpoint_path);
+  EXPECT_EQ(2, restored.get_current_q());
+
+  // continuing either session leads to the same state.
+  session.step();
+  restored.step();
+  std::stringstream expected, actual;
+  session.save_checkpoint(expected);
+  restored.save_checkpoint(actual);
+  EXPECT_EQ(expected.str(), actual.str());
+
+  std::stringstream garbage("not a checkpoint");
+  EXPECT_THROW(restored.load_checkpoint(garbage), std::logic_error);
+  EXPECT_EQ(3, restored.get_current_q());
+}
@@ -1,9 +1,13 @@
+#include <vector>
+
 #include <gmpxx.h>
 
 #include "gtest/gtest.h"
 
 #include "../src/matrix.h"
+#include "../src/p_local.h"
 #include "../src/smith.h"
+#include "../src/thread_pool.h"
 
 TEST(SmithReduceP, Empty)
 {
@@ -46,3 +50,248 @@ TEST(SmithReduceP, AntiDiagonal)
 
   EXPECT_EQ(MatrixQ({{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}), f);
 }
+
+TEST(SmithReduceP, FixedPrime)
+{
+  MatrixQ f = {{4, 6, 1_mpq / 3}, {2, 8, 12}, {0, 24, 5}};
+  MatrixQ g = f;
+  MatrixQ f_from = MatrixQ::identity(3);
+  MatrixQ g_from = f_from;
+
+  auto to_X = MatrixQRefList();
+  auto from_X = MatrixQRefList({f_from});
+  auto to_Y = MatrixQRefList();
+  auto from_Y = MatrixQRefList();
+  smith_reduce_p(2, f, to_X, from_X, to_Y, from_Y);
+
+  auto from_X_2 = MatrixQRefList({g_from});
+  smith_reduce_p<mpq_class, 2>(2, g, to_X, from_X_2, to_Y, from_Y);
+
+  EXPECT_EQ(f, g);
+  EXPECT_EQ(f_from, g_from);
+}
+
+TEST(SmithReduceP, BasisChange)
+{
+  const MatrixQ f_0 = {{6, 3, 1_mpq / 2, 9},
+                       {2, 0, 4, 3},
+                       {0, 27, 5, 1},
+                       {3, 3, 3, 3},
+                       {1_mpq / 5, 9, 0, 6}};
+  MatrixQ f = f_0;
+
+  BasisChange<mpq_class> X_change;
+  BasisChange<mpq_class> Y_change;
+  smith_reduce_p(3, f, X_change, Y_change);
+
+  // the changes of basis, and maps with several blocks.
+  MatrixQ U = MatrixQ::identity(5);
+  MatrixQ U_inv = MatrixQ::identity(5);
+  MatrixQ V = MatrixQ::identity(4);
+  MatrixQ V_inv = MatrixQ::identity(4);
+  MatrixQ wide(5, 3 * basis_change_block + 1);
+  MatrixQ tall(2 * basis_change_block + 3, 4, Layout::column_major);
+  for (dim_t j = 0; j < wide.width(); ++j) {
+    wide(j % 5, j) = j + 1;
+  }
+  for (dim_t i = 0; i < tall.height(); ++i) {
+    tall(i, i % 4) = mpq_class(1, i + 1);
+  }
+  const MatrixQ wide_0 = wide;
+  const MatrixQ tall_0 = tall;
+
+  unsigned int threads = get_thread_count();
+  set_thread_count(4);
+  auto to_X = MatrixQRefList({V_inv});
+  auto from_X = MatrixQRefList({V, tall});
+  auto to_Y = MatrixQRefList({U, wide});
+  auto from_Y = MatrixQRefList({U_inv});
+  X_change.apply(to_X, from_X);
+  Y_change.apply(to_Y, from_Y);
+  set_thread_count(threads);
+
+  EXPECT_EQ(f, U * f_0 * V);
+  EXPECT_EQ(MatrixQ(MatrixQ::identity(5)), U * U_inv);
+  EXPECT_EQ(MatrixQ(MatrixQ::identity(4)), V * V_inv);
+  EXPECT_EQ(U * wide_0, wide);
+  EXPECT_EQ(tall_0 * V, tall);
+
+  // the same as applying the changes right away.
+  MatrixQ g = f_0;
+  MatrixQ g_from = MatrixQ::identity(4);
+  auto to_X_2 = MatrixQRefList();
+  auto from_X_2 = MatrixQRefList({g_from});
+  auto to_Y_2 = MatrixQRefList();
+  auto from_Y_2 = MatrixQRefList();
+  smith_reduce_p(3, g, to_X_2, from_X_2, to_Y_2, from_Y_2);
+  EXPECT_EQ(f, g);
+  EXPECT_EQ(V, g_from);
+}
+
+// a sparse 24x20 matrix over Z_(3), with enough steps that most rows keep
+// their valuations across some of them.
+static MatrixQ larger_matrix()
+{
+  const dim_t height = 24;
+  const dim_t width = 20;
+  MatrixQ f_0(height, width);
+  for (dim_t i = 0; i < height; ++i) {
+    f_0(i, (i * 7) % width) = 9 * (i % 5 + 1);
+    f_0(i, (i * 3 + 1) % width) = mpq_class(3 * (i % 4) + 1) / 2;
+    if (i % 3 == 0) f_0(i, (i + 5) % width) = 27;
+  }
+  return f_0;
+}
+
+TEST(SmithReduceP, Larger)
+{
+  const MatrixQ f_0 = larger_matrix();
+  const dim_t height = f_0.height();
+  const dim_t width = f_0.width();
+
+  MatrixQ f = f_0;
+  MatrixQ U = MatrixQ::identity(height);
+  MatrixQ V = MatrixQ::identity(width);
+  auto to_X = MatrixQRefList();
+  auto from_X = MatrixQRefList({V});
+  auto to_Y = MatrixQRefList({U});
+  auto from_Y = MatrixQRefList();
+  smith_reduce_p(3, f, to_X, from_X, to_Y, from_Y);
+
+  EXPECT_EQ(f, U * f_0 * V);
+
+  std::vector<val_t> valuations = smith_valuations_p(3, f_0);
+  for (dim_t i = 0; i < height; ++i) {
+    for (dim_t j = 0; j < width; ++j) {
+      if (i != j || i >= valuations.size()) {
+        EXPECT_EQ(0, f(i, j));
+      } else {
+        EXPECT_EQ(p_pow<mpq_class>(3, static_cast<u_val_t>(valuations[i])),
+                  f(i, j));
+        if (i > 0) {
+          EXPECT_LE(valuations[i - 1], valuations[i]);
+        }
+      }
+    }
+  }
+}
+
+TEST(SmithReduceP, Threads)
+{
+  // large enough for the steps to run on several threads.
+  const dim_t n = 72;
+  MatrixQ f_0(n, n);
+  for (dim_t i = 0; i < n; ++i) {
+    for (dim_t j = 0; j < n; ++j) {
+      if ((i * 5 + j * 3) % 4 == 0) continue;
+      f_0(i, j) = mpq_class(static_cast<long>((i * 7 + j) % 11) - 5) *
+                  (i % 3 == 0 ? 9 : 1);
+    }
+  }
+
+  auto reduce = [&](const unsigned int threads, MatrixQ& f, MatrixQ& U,
+                    MatrixQ& V) {
+    unsigned int previous_threads = get_thread_count();
+    set_thread_count(threads);
+    f = f_0;
+    U = MatrixQ::identity(n);
+    V = MatrixQ::identity(n);
+    auto to_X = MatrixQRefList();
+    auto from_X = MatrixQRefList({V});
+    auto to_Y = MatrixQRefList({U});
+    auto from_Y = MatrixQRefList();
+    smith_reduce_p(3, f, to_X, from_X, to_Y, from_Y);
+    std::vector<val_t> valuations = smith_valuations_p(3, f_0);
+    set_thread_count(previous_threads);
+    return valuations;
+  };
+
+  MatrixQ f_1, U_1, V_1, f_4, U_4, V_4;
+  std::vector<val_t> valuations_1 = reduce(1, f_1, U_1, V_1);
+  std::vector<val_t> valuations_4 = reduce(4, f_4, U_4, V_4);
+
+  EXPECT_EQ(f_1, f_4);
+  EXPECT_EQ(U_1, U_4);
+  EXPECT_EQ(V_1, V_4);
+  EXPECT_EQ(valuations_1, valuations_4);
+  EXPECT_EQ(f_4, U_4 * f_0 * V_4);
+}
+
+TEST(SmithReduceP, SparseEngine)
+{
+  const MatrixQ f_0 = larger_matrix();
+  const dim_t height = f_0.height();
+  const dim_t width = f_0.width();
+
+  MatrixQ f = f_0;
+  MatrixQ U = MatrixQ::identity(height);
+  MatrixQ U_inv = MatrixQ::identity(height);
+  MatrixQ V = MatrixQ::identity(width);
+  MatrixQ V_inv = MatrixQ::identity(width);
+  auto to_X = MatrixQRefList({V_inv});
+  auto from_X = MatrixQRefList({V});
+  auto to_Y = MatrixQRefList({U});
+  auto from_Y = MatrixQRefList({U_inv});
+
+  {
+    SmithEngineScope engine(SmithEngine::sparse);
+    smith_reduce_p(3, f, to_X, from_X, to_Y, from_Y);
+  }
+
+  EXPECT_EQ(f, U * f_0 * V);
+  EXPECT_EQ(MatrixQ(MatrixQ::identity(height)), U * U_inv);
+  EXPECT_EQ(MatrixQ(MatrixQ::identity(width)), V * V_inv);
+
+  // the same normal form as the dense elimination.
+  MatrixQ g = f_0;
+  auto none = MatrixQRefList();
+  smith_reduce_p(3, g, none, none, none, none);
+  EXPECT_EQ(g, f);
+}
+
+TEST(SmithReduceP, BlockElimination)
+{
+  // several blocks, with pivots of different valuations and dependent rows.
+  const dim_t height = 90;
+  const dim_t width = 80;
+  MatrixQ f_0(height, width);
+  for (dim_t i = 0; i < height; ++i) {
+    for (dim_t j = 0; j < width; ++j) {
+      if ((i * 5 + j * 3) % 4 == 0) continue;
+      f_0(i, j) = mpq_class(static_cast<long>((i * 7 + j * j) % 13) - 6) /
+                  (j % 2 == 0 ? 2 : 5) * (i % 3 == 0 ? 9 : 1) *
+                  (j % 4 == 0 ? 3 : 1);
+    }
+  }
+  for (dim_t i = 60; i < height; ++i) {
+    for (dim_t j = 0; j < width; ++j) {
+      f_0(i, j) = 3 * f_0(i - 60, j) - f_0(i - 30, j);
+    }
+  }
+
+  MatrixQ f = f_0;
+  MatrixQ U = MatrixQ::identity(height);
+  MatrixQ U_inv = MatrixQ::identity(height);
+  MatrixQ V = MatrixQ::identity(width);
+  MatrixQ V_inv = MatrixQ::identity(width);
+  auto to_X = MatrixQRefList({V_inv});
+  auto from_X = MatrixQRefList({V});
+  auto to_Y = MatrixQRefList({U});
+  auto from_Y = MatrixQRefList({U_inv});
+
+  BasisChange<mpq_class> X_change;
+  BasisChange<mpq_class> Y_change;
+  block_smith_reduce_p(3, f, X_change, Y_change);
+  X_change.apply(to_X, from_X);
+  Y_change.apply(to_Y, from_Y);
+
+  EXPECT_EQ(f, U * f_0 * V);
+  EXPECT_EQ(MatrixQ(MatrixQ::identity(height)), U * U_inv);
+  EXPECT_EQ(MatrixQ(MatrixQ::identity(width)), V * V_inv);
+
+  // the same normal form as the elimination one pivot at a time.
+  MatrixQ g = f_0;
+  BasisChange<mpq_class> none;
+  dense_smith_reduce_p(3, g, none, none);
+  EXPECT_EQ(g, f);
+}
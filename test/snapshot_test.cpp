@@ -0,0 +1,68 @@
+#include "gtest/gtest.h"
+
+#include <sstream>
+#include <stdexcept>
+
+#include "../src/snapshot.h"
+
+TEST(Snapshot, Integers)
+{
+  std::stringstream stream;
+  write_uint(stream, 0);
+  write_uint(stream, 0x0123456789abcdefULL);
+  write_int(stream, -5);
+  EXPECT_EQ(24u, stream.str().size());
+
+  EXPECT_EQ(0u, read_uint(stream));
+  EXPECT_EQ(0x0123456789abcdefULL, read_uint(stream));
+  EXPECT_EQ(-5, read_int(stream));
+  EXPECT_THROW(read_uint(stream), std::logic_error);
+}
+
+TEST(Snapshot, Rationals)
+{
+  mpq_class big("-123456789012345678901234567890/7");
+  std::stringstream stream;
+  write_mpq(stream, 0);
+  write_mpq(stream, mpq_class(3, 4));
+  write_mpq(stream, big);
+
+  mpq_class value;
+  read_mpq(stream, value);
+  EXPECT_EQ(0, value);
+  read_mpq(stream, value);
+  EXPECT_EQ(mpq_class(3, 4), value);
+  read_mpq(stream, value);
+  EXPECT_EQ(big, value);
+}
+
+TEST(Snapshot, MatrixAndGroup)
+{
+  MatrixQ matrix({{1, -2, 0}, {mpq_class(5, 3), 7, 9}});
+  AbelianGroup group(2, 3);
+  group(0) = 1;
+  group(1) = 4;
+  group(2) = 4;
+
+  std::stringstream stream;
+  write_matrix(stream, matrix);
+  write_group(stream, group);
+
+  EXPECT_EQ(matrix, read_matrix(stream));
+  AbelianGroup read = read_group(stream);
+  EXPECT_EQ(2u, read.free_rank());
+  ASSERT_EQ(3u, read.tor_rank());
+  EXPECT_EQ(1u, read(0));
+  EXPECT_EQ(4u, read(1));
+  EXPECT_EQ(4u, read(2));
+}
+
+TEST(Snapshot, Truncated)
+{
+  std::stringstream full;
+  write_matrix(full, MatrixQ({{1, 2}, {3, 4}}));
+  const std::string bytes = full.str();
+
+  std::stringstream truncated(bytes.substr(0, bytes.size() - 1));
+  EXPECT_THROW(read_matrix(truncated), std::logic_error);
+}
@@ -0,0 +1,43 @@
+#include <exception>
+
+#include <gmpxx.h>
+
+#include "gtest/gtest.h"
+
+#include "../src/matrix.h"
+#include "../src/sparse_matrix.h"
+
+TEST(SparseMatrix, FromDense)
+{
+  MatrixQ f = {{0, 2, 0}, {0, 0, 0}, {1_mpq / 3, 0, 5}};
+  SparseMatrixQ s(f);
+
+  EXPECT_EQ(3u, s.nonzeros());
+  EXPECT_EQ(2_mpq, s(0, 1));
+  EXPECT_EQ(0_mpq, s(1, 1));
+  EXPECT_EQ(5_mpq, s(2, 2));
+  EXPECT_EQ(f, s);
+  EXPECT_EQ(f, s.dense());
+  EXPECT_EQ(MatrixQ(0, 0), SparseMatrixQ().dense());
+}
+
+TEST(SparseMatrix, BlockDiagonal)
+{
+  SparseMatrixQ s(MatrixQ({{1, 0, 2}}));
+
+  EXPECT_EQ(MatrixQ({{1, 0, 2, 0, 0, 0}, {0, 0, 0, 1, 0, 2}}),
+            SparseMatrixQ::block_diagonal(s, 2).dense());
+  EXPECT_EQ(0u, SparseMatrixQ::block_diagonal(s, 0).height());
+}
+
+TEST(SparseMatrix, Products)
+{
+  MatrixQ f = {{0, 2, 0}, {0, 0, 0}, {1_mpq / 3, 0, 5}};
+  MatrixQ g = {{1, 2}, {3, 4}, {5, 6}};
+  MatrixQ h = {{1, 0, 1}, {0, 7, 0}};
+  SparseMatrixQ s(f);
+
+  EXPECT_EQ(f * g, s * g);
+  EXPECT_EQ(h * f, h * s);
+  EXPECT_THROW(g * s, std::logic_error);
+}
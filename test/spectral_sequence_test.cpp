@@ -54,3 +54,130 @@ TEST(GroupSequence, GetMatrix)
   EXPECT_THROW(seq.get_matrix(3), std::logic_error);
   EXPECT_EQ(MatrixQ::identity(2), seq.get_matrix(2));
 }
+
+TEST(SpectralSequence, EabCache)
+{
+  SpectralSequence sequence(2);
+  sequence.set_bounds(0, 0, 0);
+  sequence.set_bounds(1, 0, 1);
+
+  AbelianGroup Z_4(0, 1);
+  Z_4(0) = 2;
+  AbelianGroup Z_2(0, 1);
+  Z_2(0) = 1;
+  TrigradedIndex source_pqs(2, 0, 0);
+  TrigradedIndex target_pqs = target(source_pqs, 2);
+  sequence.set_e2(source_pqs, Z_4);
+  sequence.set_e2(target_pqs, Z_2);
+
+  EXPECT_EQ(2, sequence.get_e_ab(source_pqs, 2, 2).group(0));
+  EXPECT_EQ(0, sequence.get_e_ab_cache_hits());
+  EXPECT_EQ(1, sequence.get_e_ab_cache_misses());
+
+  // a and b below 2 read E_2 as well.
+  EXPECT_EQ(2, sequence.get_e_ab(source_pqs, 1, 2).group(0));
+  EXPECT_EQ(2, sequence.get_e_ab_group(source_pqs, 2, 2)(0));
+  EXPECT_EQ(2, sequence.get_e_ab_cache_hits());
+  EXPECT_EQ(1, sequence.get_e_ab_cache_misses());
+
+  // d_2 maps Z/4 onto Z/2, which leaves the E_2 terms as they were.
+  sequence.set_diff(source_pqs, 2, MatrixQ({{1}}));
+  EXPECT_EQ(2, sequence.get_e_ab(source_pqs, 2, 2).group(0));
+  EXPECT_EQ(3, sequence.get_e_ab_cache_hits());
+
+  AbelianGroup e_3 = sequence.get_e_ab_group(source_pqs, 3, 2);
+  ASSERT_EQ(1, e_3.tor_rank());
+  EXPECT_EQ(1, e_3(0));
+  EXPECT_EQ(0, sequence.get_e_ab_group(target_pqs, 2, 3).rank());
+  EXPECT_EQ(0, sequence.get_e_ab_group(target_pqs, 2, 3).rank());
+  EXPECT_EQ(4, sequence.get_e_ab_cache_hits());
+  EXPECT_EQ(3, sequence.get_e_ab_cache_misses());
+}
+
+TEST(SpectralSequence, DiffFromReferencesStoredMatrices)
+{
+  SpectralSequence sequence(2);
+  sequence.set_bounds(0, 0, 0);
+  sequence.set_bounds(1, 0, 1);
+
+  AbelianGroup Z_4(0, 1);
+  Z_4(0) = 2;
+  AbelianGroup Z_2(0, 1);
+  Z_2(0) = 1;
+  TrigradedIndex zero_pqs(4, 0, 0);
+  TrigradedIndex source_pqs(2, 0, 0);
+  TrigradedIndex target_pqs = target(source_pqs, 2);
+  sequence.set_e2(zero_pqs, Z_4);
+  sequence.set_e2(target(zero_pqs, 2), Z_2);
+  sequence.set_e2(source_pqs, Z_4);
+  sequence.set_e2(target_pqs, Z_2);
+
+  sequence.set_diff_zero(zero_pqs, 2);
+  DifferentialRef zero = sequence.get_diff_from(zero_pqs, 2);
+  EXPECT_TRUE(zero.is_implicit_zero());
+  EXPECT_EQ(1, zero.height());
+  EXPECT_EQ(1, zero.width());
+  EXPECT_EQ(MatrixQ(1, 1), zero.matrix());
+
+  sequence.set_diff(source_pqs, 2, MatrixQ({{1}}));
+  DifferentialRef diff = sequence.get_diff_from(source_pqs, 2);
+  EXPECT_FALSE(diff.is_implicit_zero());
+  EXPECT_EQ(MatrixQ({{1}}), diff.matrix());
+  EXPECT_EQ(&diff.matrix(), &sequence.get_diff_to(target_pqs, 2).matrix());
+
+  EXPECT_EQ(&sequence.get_inclusion(source_pqs, 3),
+            &sequence.get_inclusion(source_pqs, 3));
+  EXPECT_EQ(&sequence.get_projection(target_pqs, 3),
+            &sequence.get_projection(target_pqs, 3));
+}
+
+TEST(TrigradedGrid, FindAndEmplace)
+{
+  TrigradedGrid<int> grid;
+  EXPECT_EQ(grid.find(TrigradedIndex(0, 0, 0)), nullptr);
+
+  grid.emplace(TrigradedIndex(1, 2, 1), 5);
+  grid.emplace(TrigradedIndex(0, 3, 2), 7);
+  // widens the diagonal p + q = 3 after it has entries.
+  grid.emplace(TrigradedIndex(2, 1, 4), 9);
+  grid.emplace(TrigradedIndex(0, 0, 0), 1);
+  // does not overwrite.
+  EXPECT_EQ(grid.emplace(TrigradedIndex(1, 2, 1), 6), 5);
+
+  EXPECT_EQ(grid.size(), 4u);
+  EXPECT_EQ(*grid.find(TrigradedIndex(1, 2, 1)), 5);
+  EXPECT_EQ(*grid.find(TrigradedIndex(0, 3, 2)), 7);
+  EXPECT_EQ(*grid.find(TrigradedIndex(2, 1, 4)), 9);
+  EXPECT_EQ(*grid.find(TrigradedIndex(0, 0, 0)), 1);
+  EXPECT_EQ(grid.find(TrigradedIndex(1, 2, 2)), nullptr);
+  EXPECT_EQ(grid.find(TrigradedIndex(3, 0, 1)), nullptr);
+  EXPECT_EQ(grid.find(TrigradedIndex(4, 0, 1)), nullptr);
+  EXPECT_EQ(grid.find(TrigradedIndex(-1, 4, 1)), nullptr);
+  EXPECT_EQ(grid.find(TrigradedIndex(1, 2, -1)), nullptr);
+
+  *grid.find(TrigradedIndex(0, 0, 0)) = 2;
+  EXPECT_EQ(*grid.find(TrigradedIndex(0, 0, 0)), 2);
+}
+
+TEST(TrigradedGrid, ForEachInIndexOrder)
+{
+  TrigradedGrid<int> grid;
+  std::vector<TrigradedIndex> indices{
+      TrigradedIndex(2, 1, 4), TrigradedIndex(0, 3, 2),
+      TrigradedIndex(1, 2, 1), TrigradedIndex(0, 0, 0),
+      TrigradedIndex(0, 3, 1), TrigradedIndex(1, 1, 1)};
+  for (std::size_t i = 0; i < indices.size(); ++i) {
+    grid.emplace(indices[i], static_cast<int>(i));
+  }
+
+  std::vector<TrigradedIndex> visited;
+  grid.for_each([&](const TrigradedIndex& pqs, const int value) {
+    EXPECT_EQ(indices[static_cast<std::size_t>(value)], pqs);
+    visited.push_back(pqs);
+  });
+
+  ASSERT_EQ(visited.size(), indices.size());
+  for (std::size_t i = 1; i < visited.size(); ++i) {
+    EXPECT_TRUE(visited[i - 1] < visited[i]);
+  }
+}
@@ -0,0 +1,308 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.h"
+
+#include "../src/session.h"
+#include "../src/task.h"
+#include "../src/task_scheduler.h"
+#include "../src/thread_pool.h"
+
+// a task that sets E_2 at pqs once E_2 is set at all of inputs, and logs
+// its id when it does.
+class E2Task : public Task
+{
+ public:
+  E2Task(Session& session, SpectralSequence& sequence, std::vector<int>& log,
+         const int id, const TrigradedIndex pqs,
+         const std::vector<TrigradedIndex>& inputs)
+      : Task(session),
+        sequence_(sequence),
+        log_(log),
+        id_(id),
+        pqs_(pqs),
+        inputs_(inputs)
+  {
+  }
+
+  bool autosolve() override
+  {
+    if (!solvable) return false;
+    sequence_.set_e2(pqs_, AbelianGroup(1, 0));
+    std::lock_guard<std::mutex> lock(log_mutex_);
+    log_.push_back(id_);
+    return true;
+  }
+
+  bool usersolve() override
+  {
+    return false;
+  }
+
+  void display_overview() override
+  {
+  }
+
+  void display_detail() override
+  {
+  }
+
+  std::vector<SequenceState> reads() const override
+  {
+    std::vector<SequenceState> states;
+    for (const TrigradedIndex& input : inputs_) {
+      states.push_back({input, true, 2});
+    }
+    return states;
+  }
+
+  std::vector<SequenceState> writes() const override
+  {
+    return {{pqs_, true, 2}, {pqs_, false, 2}};
+  }
+
+  void save(std::ostream&) const override
+  {
+  }
+
+  bool solvable = true;
+
+ private:
+  // the tasks of a wave log from several threads.
+  static std::mutex log_mutex_;
+
+  SpectralSequence& sequence_;
+  std::vector<int>& log_;
+  int id_;
+  TrigradedIndex pqs_;
+  std::vector<TrigradedIndex> inputs_;
+};
+
+std::mutex E2Task::log_mutex_;
+
+// forwards to task, but only solves it once count tasks sharing started
+// have begun to, so that they have to run on different threads, and keeps
+// the thread it ran on in thread. Gives up waiting after five seconds.
+class BarrierTask : public Task
+{
+ public:
+  BarrierTask(Session& session, std::unique_ptr<Task> task,
+              std::atomic<int>& started, const int count,
+              std::thread::id& thread)
+      : Task(session),
+        task_(std::move(task)),
+        started_(started),
+        count_(count),
+        thread_(thread)
+  {
+  }
+
+  bool autosolve() override
+  {
+    thread_ = std::this_thread::get_id();
+    ++started_;
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (started_ < count_ && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+    return task_->autosolve();
+  }
+
+  bool usersolve() override
+  {
+    return false;
+  }
+
+  void display_overview() override
+  {
+  }
+
+  void display_detail() override
+  {
+  }
+
+  std::vector<SequenceState> reads() const override
+  {
+    return task_->reads();
+  }
+
+  std::vector<SequenceState> writes() const override
+  {
+    return task_->writes();
+  }
+
+  void save(std::ostream& stream) const override
+  {
+    task_->save(stream);
+  }
+
+ private:
+  std::unique_ptr<Task> task_;
+  std::atomic<int>& started_;
+  int count_;
+  std::thread::id& thread_;
+};
+
+class TaskSchedulerTest : public ::testing::Test
+{
+ protected:
+  TaskSchedulerTest()
+      : session_(2, TEST_DATA_DIR + "SessionInitParse/ranks.dat",
+                 TEST_DATA_DIR + "SessionInitParse/v_inclusions.dat",
+                 TEST_DATA_DIR + "SessionInitParse/r_operations.dat.", 10),
+        sequence_(2)
+  {
+    sequence_.set_bounds(0, 0, 0);
+    sequence_.set_bounds(1, 0, 1);
+  }
+
+  E2Task* add(const int id, const TrigradedIndex pqs,
+              const std::vector<TrigradedIndex>& inputs)
+  {
+    E2Task* task = new E2Task(session_, sequence_, log_, id, pqs, inputs);
+    scheduler_.add(std::unique_ptr<Task>(task));
+    return task;
+  }
+
+  Session session_;
+  SpectralSequence sequence_;
+  TaskScheduler scheduler_;
+  std::vector<int> log_;
+};
+
+TEST_F(TaskSchedulerTest, RunsInDependencyOrder)
+{
+  add(0, TrigradedIndex(2, 1, 1), {TrigradedIndex(1, 1, 0)});
+  add(1, TrigradedIndex(1, 1, 0), {TrigradedIndex(0, 0, 0)});
+  add(2, TrigradedIndex(0, 0, 0), {});
+  // already holds, so it does not wait.
+  sequence_.set_e2(TrigradedIndex(0, 1, 1), AbelianGroup(1, 0));
+  add(3, TrigradedIndex(1, 0, 0), {TrigradedIndex(0, 1, 1)});
+
+  EXPECT_TRUE(scheduler_.run(sequence_).empty());
+  // 2 and 3 run in the same wave, in either order.
+  ASSERT_EQ(4u, log_.size());
+  std::sort(log_.begin(), log_.begin() + 2);
+  EXPECT_EQ(std::vector<int>({2, 3, 1, 0}), log_);
+  EXPECT_EQ(0u, scheduler_.size());
+}
+
+TEST_F(TaskSchedulerTest, ReturnsUnsolvedTasks)
+{
+  E2Task* blocked = add(0, TrigradedIndex(0, 0, 0), {});
+  blocked->solvable = false;
+  add(1, TrigradedIndex(1, 0, 0), {TrigradedIndex(0, 0, 0)});
+  add(2, TrigradedIndex(2, 0, 0), {});
+
+  std::list<std::unique_ptr<Task>> unsolved = scheduler_.run(sequence_);
+  ASSERT_EQ(1u, unsolved.size());
+  EXPECT_EQ(blocked, unsolved.front().get());
+  EXPECT_EQ(std::vector<int>({2}), log_);
+  EXPECT_EQ(1u, scheduler_.size());
+
+  blocked->solvable = true;
+  blocked->autosolve();
+  EXPECT_TRUE(scheduler_.run(sequence_).empty());
+  EXPECT_EQ(std::vector<int>({2, 0, 1}), log_);
+}
+
+TEST_F(TaskSchedulerTest, MissingOrDuplicateWriter)
+{
+  add(0, TrigradedIndex(1, 0, 0), {TrigradedIndex(0, 0, 0)});
+  EXPECT_THROW(scheduler_.run(sequence_), std::logic_error);
+
+  scheduler_.clear();
+  add(0, TrigradedIndex(0, 0, 0), {});
+  add(1, TrigradedIndex(0, 0, 0), {});
+  EXPECT_THROW(scheduler_.run(sequence_), std::logic_error);
+}
+
+TEST_F(TaskSchedulerTest, Cycle)
+{
+  add(0, TrigradedIndex(1, 0, 0), {TrigradedIndex(0, 0, 0)});
+  add(1, TrigradedIndex(0, 0, 0), {TrigradedIndex(1, 0, 0)});
+  EXPECT_THROW(scheduler_.run(sequence_), std::logic_error);
+}
+
+// a session after two steps, with E_2 set for the next q the way the third
+// step sets it, so that the differentials from q = 0 to q = 1 can run.
+static void prepare_differentials(Session& session)
+{
+  session.step();
+  session.step();
+
+  SpectralSequence& sequence = session.get_sequence();
+  sequence.set_bounds(3, 1, 3);
+  TaskScheduler groups;
+  for (deg_t p = 1; p <= 6; ++p) {
+    groups.add(
+        std::unique_ptr<Task>(new GroupTask(session, p, 2 - (p - 1) / 2)));
+  }
+  ASSERT_TRUE(groups.run(sequence).empty());
+}
+
+TEST(TaskScheduler, ParallelDifferentials)
+{
+  const std::string prefix = TEST_DATA_DIR + "SessionInitParse/";
+  Session parallel(2, prefix + "ranks.dat", prefix + "v_inclusions.dat",
+                   prefix + "r_operations.dat.", 10);
+  Session serial(2, prefix + "ranks.dat", prefix + "v_inclusions.dat",
+                 prefix + "r_operations.dat.", 10);
+  prepare_differentials(parallel);
+  prepare_differentials(serial);
+
+  // d_2 from (6,0,0) is computed from the operations, d_2 from (5,0,0) is
+  // zero. Neither reads what the other writes.
+  const std::vector<TrigradedIndex> sources = {TrigradedIndex(6, 0, 0),
+                                               TrigradedIndex(5, 0, 0)};
+  for (const TrigradedIndex& source : sources) {
+    DifferentialTask task(parallel, source, 2);
+    for (const SequenceState& state : task.reads()) {
+      ASSERT_TRUE(parallel.get_sequence().reached(state));
+    }
+    for (const SequenceState& state : task.writes()) {
+      ASSERT_FALSE(parallel.get_sequence().reached(state));
+    }
+  }
+
+  unsigned int threads = get_thread_count();
+  set_thread_count(4);
+  std::atomic<int> started(0);
+  std::vector<std::thread::id> ran_on(sources.size());
+  TaskScheduler scheduler;
+  for (dim_t i = 0; i < sources.size(); ++i) {
+    scheduler.add(std::unique_ptr<Task>(new BarrierTask(
+        parallel,
+        std::unique_ptr<Task>(new DifferentialTask(parallel, sources[i], 2)),
+        started, 2, ran_on[i])));
+  }
+  const bool solved = scheduler.run(parallel.get_sequence()).empty();
+  set_thread_count(threads);
+  ASSERT_TRUE(solved);
+  EXPECT_NE(ran_on[0], ran_on[1]);
+
+  set_thread_count(1);
+  for (const TrigradedIndex& source : sources) {
+    scheduler.add(
+        std::unique_ptr<Task>(new DifferentialTask(serial, source, 2)));
+  }
+  const bool serial_solved = scheduler.run(serial.get_sequence()).empty();
+  set_thread_count(threads);
+  ASSERT_TRUE(serial_solved);
+
+  std::stringstream expected;
+  std::stringstream actual;
+  serial.save_checkpoint(expected);
+  parallel.save_checkpoint(actual);
+  EXPECT_EQ(expected.str(), actual.str());
+}
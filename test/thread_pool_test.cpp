@@ -0,0 +1,53 @@
+#include <atomic>
+#include <exception>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "../src/thread_pool.h"
+
+TEST(ThreadPool, Run)
+{
+  ThreadPool pool(4);
+  EXPECT_EQ(4u, pool.threads());
+
+  std::vector<int> visited(100, 0);
+  pool.run(0, visited.size(), [&](const dim_t i) { ++visited[i]; });
+  EXPECT_EQ(std::vector<int>(100, 1), visited);
+
+  pool.run(10, 20, [&](const dim_t i) { ++visited[i]; });
+  EXPECT_EQ(2, visited[15]);
+  EXPECT_EQ(1, visited[20]);
+}
+
+TEST(ThreadPool, Exception)
+{
+  ThreadPool pool(3);
+  EXPECT_THROW(pool.run(0, 10,
+                        [](const dim_t i) {
+                          if (i == 5) throw std::logic_error("test");
+                        }),
+               std::logic_error);
+
+  std::atomic<dim_t> sum(0);
+  pool.run(0, 10, [&](const dim_t i) { sum += i; });
+  EXPECT_EQ(45u, sum.load());
+}
+
+TEST(ThreadPool, ParallelFor)
+{
+  unsigned int threads = get_thread_count();
+  set_thread_count(3);
+  EXPECT_EQ(3u, get_thread_count());
+
+  std::atomic<dim_t> sum(0);
+  parallel_for(0, 50, [&](const dim_t i) {
+    // nested loops run serially on the calling thread.
+    parallel_for(0, 2, [&](const dim_t j) { sum += i * j; });
+  });
+  EXPECT_EQ(1225u, sum.load());
+
+  set_thread_count(0);
+  EXPECT_EQ(1u, get_thread_count());
+  set_thread_count(threads);
+}